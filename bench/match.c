@@ -0,0 +1,230 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Microbenchmark of the substring search kernels against strcasestr().
+ * Every kernel searches the same synthetic list of folded names for
+ * needles of different lengths; strcasestr() searches the unfolded names.
+ * The names are generated from a fixed seed, so every run searches the
+ * same input.
+ *
+ * Usage: match [names] [rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/match.c"
+
+#define BENCH_NAMES 100000
+#define BENCH_ROUNDS 5
+
+struct kernel {
+    const char *name;
+    bool (*find)(const struct match_query *q, const char *str);
+};
+
+static const size_t needle_lens[] = { 1, 2, 4, 8, 16, 32, 33 };
+
+static unsigned long state = 1;
+
+static unsigned int bench_rand(void)
+{
+    state = state * 6364136223846793005ul + 1442695040888963407ul;
+
+    return (unsigned int) (state >> 33);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Random names of 4 to 40 characters, mostly lower case letters */
+static char *bench_names(char **names, size_t n)
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzaeiouABCD"
+                                   "EFGHIJKLMNOPQRSTUVWXYZ0123456789-._";
+    size_t size = n * 41, used = 0;
+    char *blob = malloc(size);
+
+    if (!blob)
+        die("Out of memory\n");
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t len = 4 + bench_rand() % 37;
+
+        names[i] = blob + used;
+
+        for (size_t j = 0; j < len; ++j) {
+            size_t k = bench_rand() % (sizeof(alphabet) - 1);
+
+            /* Upper case letters, digits etc. are rare */
+            if (k >= 31 && bench_rand() % 4)
+                k = bench_rand() % 26;
+
+            blob[used++] = alphabet[k];
+        }
+
+        blob[used++] = '\0';
+    }
+
+    return blob;
+}
+
+static size_t run_kernel(const struct kernel *k,
+                         const struct match_query *q,
+                         char **names,
+                         size_t n)
+{
+    size_t hits = 0;
+
+    for (size_t i = 0; i < n; ++i)
+        hits += k->find(q, names[i]);
+
+    return hits;
+}
+
+static size_t run_strcasestr(const char *needle, char **names, size_t n)
+{
+    size_t hits = 0;
+
+    for (size_t i = 0; i < n; ++i)
+        hits += strcasestr(names[i], needle) != NULL;
+
+    return hits;
+}
+
+int main(int argc, char *argv[])
+{
+    struct kernel kernels[3];
+    struct match_query q;
+    size_t n = BENCH_NAMES, rounds = BENCH_ROUNDS, n_kernels = 0;
+    char **names, **folded, *blob, *folded_blob;
+
+    if (argc > 1)
+        n = strtoul(argv[1], NULL, 10);
+
+    if (argc > 2)
+        rounds = strtoul(argv[2], NULL, 10);
+
+    if (!n || !rounds)
+        die("Usage: %s [names] [rounds]\n", argv[0]);
+
+    kernels[n_kernels++] = (struct kernel){ "scalar", &match_find_scalar };
+#ifdef __SSE2__
+    kernels[n_kernels++] = (struct kernel){ "sse2", &match_find_sse2 };
+
+    if (__builtin_cpu_supports("avx2"))
+        kernels[n_kernels++] = (struct kernel){ "avx2", &match_find_avx2 };
+#endif
+
+    names = malloc(n * sizeof(*names));
+    folded = malloc(n * sizeof(*folded));
+    if (!names || !folded)
+        die("Out of memory\n");
+
+    blob = bench_names(names, n);
+
+    folded_blob = malloc(n * 41);
+    if (!folded_blob)
+        die("Out of memory\n");
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t len = strlen(names[i]);
+
+        folded[i] = folded_blob + (names[i] - blob);
+        utf8_fold(folded[i], names[i], len + 1);
+    }
+
+    match_query_init(&q);
+
+    printf("%zu names, best of %zu rounds, ns per name\n", n, rounds);
+    printf("%6s %8s", "needle", "hits");
+
+    for (size_t i = 0; i < n_kernels; ++i)
+        printf(" %8s", kernels[i].name);
+
+    printf(" %10s\n", "strcasestr");
+
+    for (size_t i = 0; i < sizeof(needle_lens) / sizeof(*needle_lens); ++i) {
+        size_t len = needle_lens[i], hits = 0;
+        char needle[64];
+        const char *name;
+        double best;
+
+        /* Take the needle from a name, so there is at least one hit */
+        do {
+            name = names[bench_rand() % n];
+        } while (strlen(name) < len);
+
+        memcpy(needle, name, len);
+        needle[len] = '\0';
+
+        match_query_set(&q, needle, len, MATCH_SUBSTRING);
+
+        for (size_t j = 0; j <= n_kernels; ++j) {
+            best = 1e9;
+
+            for (size_t r = 0; r < rounds; ++r) {
+                double start = now();
+                size_t found;
+
+                if (j < n_kernels)
+                    found = run_kernel(&kernels[j], &q, folded, n);
+                else
+                    found = run_strcasestr(needle, names, n);
+
+                start = now() - start;
+                if (start < best)
+                    best = start;
+
+                if (j == 0 && r == 0) {
+                    hits = found;
+                    printf("%6zu %8zu", len, hits);
+                } else if (found != hits) {
+                    die("Kernels disagree for \"%s\"\n", needle);
+                }
+            }
+
+            printf((j < n_kernels) ? " %8.1f" : " %10.1f", best * 1e6 / n);
+        }
+
+        printf("\n");
+    }
+
+    match_query_destroy(&q);
+    free(folded_blob);
+    free(blob);
+    free(folded);
+    free(names);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,355 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Benchmark of the scan of the directories in ${PATH}. A synthetic
+ * directory with a mix of executables, symbolic links to them and
+ * non-executable files is created in ${TMPDIR}. The scan is compared
+ * against the readdir() and fstatat() loop it replaced, and its checks
+ * alone are timed with the synchronous fstatat() path and the batched
+ * io_uring statx() path. The static functions of the loader are used
+ * directly.
+ *
+ * Every candidate still needs its mode, so the fstatat() path makes one
+ * system call per entry just like the old loop. The io_uring path makes
+ * one per SCAN_URING_ENTRIES entries, which is where the number of calls
+ * of a cold scan drops. Build it with 'make bench IO_URING=1'. The kernel
+ * hands every statx() of the batch to a worker thread, so fewer calls do
+ * not necessarily take less time: Compare the timings on the file system
+ * in question.
+ *
+ * Usage: scan [entries] [rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "../src/load.c"
+
+#define BENCH_ENTRIES 50000
+#define BENCH_ROUNDS 5
+
+/* Every n-th entry is a symbolic link or a file without the executable bit */
+#define BENCH_LINK_STRIDE 10
+#define BENCH_PLAIN_STRIDE 10
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void bench_name(char *buf, size_t size, size_t i)
+{
+    snprintf(buf, size, "cmd-%06zu", i);
+}
+
+static void bench_setup(const char *path, size_t n)
+{
+    char name[32], target[32];
+    int fd;
+
+    fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        die_error(errno, "Failed to open \"%s\"", path);
+
+    for (size_t i = 0; i < n; ++i) {
+        mode_t mode = 0755;
+        int file;
+
+        bench_name(name, sizeof(name), i);
+
+        if (i % BENCH_LINK_STRIDE == 1) {
+            bench_name(target, sizeof(target), i - 1);
+
+            if (symlinkat(target, fd, name) < 0)
+                die_error(errno, "Failed to create \"%s\"", name);
+
+            continue;
+        }
+
+        if (i % BENCH_PLAIN_STRIDE == 2)
+            mode = 0644;
+
+        file = openat(fd, name, O_WRONLY | O_CREAT | O_CLOEXEC, mode);
+        if (file < 0)
+            die_error(errno, "Failed to create \"%s\"", name);
+
+        close(file);
+    }
+
+    close(fd);
+}
+
+static void bench_cleanup(const char *path, size_t n)
+{
+    char name[32];
+    int fd;
+
+    fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        die_error(errno, "Failed to open \"%s\"", path);
+
+    for (size_t i = 0; i < n; ++i) {
+        bench_name(name, sizeof(name), i);
+        unlinkat(fd, name, 0);
+    }
+
+    close(fd);
+    rmdir(path);
+}
+
+static void bench_reset(struct scan_dir *dir)
+{
+    free(dir->names);
+    free(dir->buf);
+
+    dir->names = NULL;
+    dir->n = 0;
+    dir->buf = NULL;
+    dir->size = 0;
+}
+
+/* The checks clear the names of rejected entries, restore them */
+static void bench_fill(struct scan_dir *dir, const char **names, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        dir->names[i] = names[i];
+
+    dir->n = n;
+}
+
+/* The scan of a directory before getdents64() and 'd_type' were used */
+static size_t bench_readdir(const char *path)
+{
+    DIR *dir = opendir(path);
+    char **names = NULL;
+    size_t n = 0, n_max = 0;
+    int fd;
+
+    if (!dir)
+        die_error(errno, "Failed to open \"%s\"", path);
+
+    fd = dirfd(dir);
+
+    while (1) {
+        struct dirent *entry = readdir(dir);
+        struct stat st;
+
+        if (!entry)
+            break;
+
+        if (fstatat(fd, entry->d_name, &st, 0) < 0)
+            continue;
+
+        if (!S_ISREG(st.st_mode) || !(st.st_mode & S_IXUSR))
+            continue;
+
+        if (n >= n_max) {
+            n_max = (n_max) ? n_max * 2 - n_max / 2 : 4096;
+
+            names = realloc(names, n_max * sizeof(*names));
+            if (!names)
+                die("Out of memory\n");
+        }
+
+        names[n] = strdup(entry->d_name);
+        if (!names[n++])
+            die("Out of memory\n");
+    }
+
+    closedir(dir);
+
+    for (size_t i = 0; i < n; ++i)
+        free(names[i]);
+
+    free(names);
+
+    return n;
+}
+
+static void bench_print(const char *what, double ms, size_t n)
+{
+    printf("  %-20s %10.3f ms %8.1f ns/entry\n", what, ms, ms * 1e6 / n);
+}
+
+int main(int argc, char *argv[])
+{
+    struct scan_dir dir = { 0 };
+    const char *tmp = getenv("TMPDIR");
+    double best_readdir = 1e9, best_scan = 1e9, best_stat = 1e9;
+    size_t n = BENCH_ENTRIES, rounds = BENCH_ROUNDS, n_items;
+    char path[PATH_MAX];
+    char (*buf)[32];
+    const char **names;
+    int fd;
+
+    if (argc > 1)
+        n = strtoul(argv[1], NULL, 10);
+
+    if (argc > 2)
+        rounds = strtoul(argv[2], NULL, 10);
+
+    if (!n || !rounds)
+        die("Usage: %s [entries] [rounds]\n", argv[0]);
+
+    if (!tmp || !tmp[0])
+        tmp = "/tmp";
+
+    snprintf(path, sizeof(path), "%s/wlmenu-bench-XXXXXX", tmp);
+    if (!mkdtemp(path))
+        die_error(errno, "Failed to create a directory in \"%s\"", tmp);
+
+    umask(0022);
+    bench_setup(path, n);
+
+    dir.path = path;
+
+    /* Warm up the dentry and inode caches, all rounds run against them */
+    scan_dir(&dir);
+    n_items = dir.n;
+
+    for (size_t i = 0; i < rounds; ++i) {
+        double start;
+
+        bench_reset(&dir);
+
+        start = now();
+        scan_dir(&dir);
+        start = now() - start;
+
+        if (start < best_scan)
+            best_scan = start;
+
+        if (dir.n != n_items)
+            die("Scan found %zu instead of %zu items\n", dir.n, n_items);
+    }
+
+    for (size_t i = 0; i < rounds; ++i) {
+        double start = now();
+        size_t n_found = bench_readdir(path);
+
+        start = now() - start;
+        if (start < best_readdir)
+            best_readdir = start;
+
+        if (n_found != n_items)
+            die("readdir() found %zu instead of %zu items\n", n_found, n_items);
+    }
+
+    /* Time the checks alone on the entries of a plain read of the dir */
+    fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        die_error(errno, "Failed to open \"%s\"", path);
+
+    bench_reset(&dir);
+    dir.n_max = n;
+    dir.names = malloc(n * sizeof(*dir.names));
+    if (!dir.names)
+        die("Out of memory\n");
+
+    /* The entries only refer to their names */
+    buf = malloc(n * sizeof(*buf));
+    if (!buf)
+        die("Out of memory\n");
+
+    for (size_t i = 0; i < n; ++i) {
+        bench_name(buf[i], sizeof(buf[i]), i);
+        scan_add(&dir, buf[i]);
+    }
+
+    names = malloc(n * sizeof(*names));
+    if (!names)
+        die("Out of memory\n");
+
+    for (size_t i = 0; i < n; ++i)
+        names[i] = dir.names[i];
+
+    for (size_t i = 0; i < rounds; ++i) {
+        double start;
+
+        bench_fill(&dir, names, n);
+
+        start = now();
+        scan_stat_items(&dir, fd, 0);
+
+        start = now() - start;
+        if (start < best_stat)
+            best_stat = start;
+    }
+
+    printf("%zu entries, %zu executables, best of %zu rounds (warm caches)\n",
+           n,
+           n_items,
+           rounds);
+
+    bench_print("readdir() loop", best_readdir, n);
+    bench_print("scan_dir()", best_scan, n);
+    bench_print("fstatat()", best_stat, n);
+
+#ifdef HAVE_IO_URING
+    {
+        double best_statx = 1e9;
+        size_t n_done = 0;
+
+        for (size_t i = 0; i < rounds; ++i) {
+            double start;
+
+            bench_fill(&dir, names, n);
+
+            start = now();
+            n_done = scan_statx_items(&dir, fd);
+
+            start = now() - start;
+            if (start < best_statx)
+                best_statx = start;
+        }
+
+        if (n_done == n) {
+            bench_print("io_uring statx()", best_statx, n);
+            printf("  %-20s %10zu calls instead of %zu\n",
+                   "io_uring_enter()",
+                   (n + SCAN_URING_ENTRIES - 1) / SCAN_URING_ENTRIES,
+                   n);
+        }
+        else
+            printf("  %-20s unavailable\n", "io_uring statx()");
+    }
+#else
+    printf("  %-20s not built (make bench IO_URING=1)\n", "io_uring statx()");
+#endif
+
+    close(fd);
+    free(names);
+    free(buf);
+    bench_reset(&dir);
+    bench_cleanup(path, n);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+#include "proc-util.h"
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN alignof(max_align_t)
+
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+    size_t used;
+    alignas(max_align_t) char mem[];
+};
+
+struct arena_map {
+    struct arena_map *next;
+    void *mem;
+    size_t size;
+};
+
+static struct arena_chunk *arena_new_chunk(struct arena *a, size_t size)
+{
+    struct arena_chunk *chunk;
+
+    if (size < ARENA_CHUNK_SIZE)
+        size = ARENA_CHUNK_SIZE;
+
+    chunk = malloc(sizeof(*chunk) + size);
+    if (!chunk)
+        die("Out of memory\n");
+
+    chunk->size = size;
+    chunk->used = 0;
+
+    /*
+     * Big allocations get a chunk of their own, which is put behind
+     * the current one to not waste the space left in there.
+     */
+    if (a->chunks && size > ARENA_CHUNK_SIZE) {
+        chunk->next = a->chunks->next;
+        a->chunks->next = chunk;
+    } else {
+        chunk->next = a->chunks;
+        a->chunks = chunk;
+    }
+
+    return chunk;
+}
+
+void arena_init(struct arena *a)
+{
+    a->chunks = NULL;
+    a->maps = NULL;
+}
+
+void arena_destroy(struct arena *a)
+{
+    struct arena_chunk *chunk = a->chunks;
+
+    /* The list of mappings lives inside the chunks */
+    for (struct arena_map *map = a->maps; map; map = map->next)
+        munmap(map->mem, map->size);
+
+    while (chunk) {
+        struct arena_chunk *next = chunk->next;
+
+        free(chunk);
+        chunk = next;
+    }
+
+    arena_init(a);
+}
+
+void arena_move(struct arena *dst, struct arena *src)
+{
+    struct arena_chunk **chunk = &src->chunks;
+    struct arena_map **map = &src->maps;
+
+    /* Keep the current chunk of 'dst' in front for further allocations */
+    while (*chunk)
+        chunk = &(*chunk)->next;
+
+    if (dst->chunks) {
+        *chunk = dst->chunks->next;
+        dst->chunks->next = src->chunks;
+    } else {
+        dst->chunks = src->chunks;
+    }
+
+    while (*map)
+        map = &(*map)->next;
+
+    *map = dst->maps;
+    dst->maps = src->maps;
+
+    arena_init(src);
+}
+
+static void *arena_bump(struct arena *a, size_t size, size_t align)
+{
+    struct arena_chunk *chunk = a->chunks;
+    size_t offset = 0;
+
+    if (chunk)
+        offset = (chunk->used + align - 1) & ~(align - 1);
+
+    if (!chunk || offset > chunk->size || chunk->size - offset < size) {
+        chunk = arena_new_chunk(a, size);
+        offset = 0;
+    }
+
+    chunk->used = offset + size;
+
+    return chunk->mem + offset;
+}
+
+void *arena_alloc(struct arena *a, size_t size)
+{
+    return arena_bump(a, size ? size : 1, ARENA_ALIGN);
+}
+
+char *arena_strdup(struct arena *a, const char *str)
+{
+    return arena_strndup(a, str, strlen(str));
+}
+
+char *arena_strndup(struct arena *a, const char *str, size_t len)
+{
+    char *mem = arena_bump(a, len + 1, 1);
+
+    memcpy(mem, str, len);
+    mem[len] = '\0';
+
+    return mem;
+}
+
+void arena_add_mmap(struct arena *a, void *mem, size_t size)
+{
+    struct arena_map *map = arena_alloc(a, sizeof(*map));
+
+    map->mem = mem;
+    map->size = size;
+    map->next = a->maps;
+    a->maps = map;
+}
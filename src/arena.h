@@ -0,0 +1,57 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stddef.h>
+
+struct arena_chunk;
+struct arena_map;
+
+/*
+ * Chunked bump allocator: Allocations are never freed individually, but
+ * all at once when the arena is destroyed.
+ */
+struct arena {
+    struct arena_chunk *chunks;
+    struct arena_map *maps;
+};
+
+void arena_init(struct arena *a);
+
+void arena_destroy(struct arena *a);
+
+void arena_move(struct arena *dst, struct arena *src);
+
+void *arena_alloc(struct arena *a, size_t size);
+
+char *arena_strdup(struct arena *a, const char *str);
+
+char *arena_strndup(struct arena *a, const char *str, size_t len);
+
+void arena_add_mmap(struct arena *a, void *mem, size_t size);
+
+#endif /* ARENA_H_ */
@@ -0,0 +1,644 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "proc-util.h"
+
+#include "desktop.h"
+
+/* Desktop entries are tiny, anything larger than this is not parsed */
+#define DESKTOP_MAX_FILE_SIZE (1024 * 1024)
+
+struct desktop_list {
+    struct desktop_file *files;
+    size_t n;
+    size_t n_max;
+
+    struct arena *arena;
+};
+
+static bool has_suffix(const char *str, const char *suffix)
+{
+    size_t len = strlen(str), n = strlen(suffix);
+
+    return len > n && memcmp(str + len - n, suffix, n) == 0;
+}
+
+static void desktop_list_add(struct desktop_list *list,
+                             const char *path,
+                             const char *id,
+                             const struct timespec *mtime)
+{
+    struct desktop_file *file;
+
+    if (list->n >= list->n_max) {
+        list->n_max = (list->n_max) ? list->n_max * 2 - list->n_max / 2 : 64;
+
+        list->files = realloc(list->files, list->n_max * sizeof(*file));
+        if (!list->files)
+            die("Out of memory\n");
+    }
+
+    file = &list->files[list->n++];
+
+    file->path = arena_strdup(list->arena, path);
+    file->id = arena_strdup(list->arena, id);
+    file->mtime = *mtime;
+    file->cached = false;
+    file->shown = false;
+    file->name = NULL;
+    file->exec = NULL;
+    file->try_exec = NULL;
+    file->label = NULL;
+    file->buf = NULL;
+}
+
+/*
+ * The desktop file ID of an entry is its path relative to the
+ * "applications" directory with '/' replaced by '-'.
+ */
+static void
+desktop_list_dir(struct desktop_list *list, const char *path, const char *id)
+{
+    struct dirent *entry;
+    DIR *dir;
+
+    dir = opendir(path);
+    if (!dir)
+        return;
+
+    while ((entry = readdir(dir))) {
+        char file_path[PATH_MAX], file_id[NAME_MAX + 1];
+        struct stat st;
+        int n, err;
+
+        if (entry->d_name[0] == '.')
+            continue;
+
+        err = fstatat(dirfd(dir), entry->d_name, &st, 0);
+        if (err < 0)
+            continue;
+
+        /* clang-format off */
+        n = snprintf(file_path, sizeof(file_path), "%s/%s",
+                     path, entry->d_name);
+        /* clang-format on */
+        if (n < 0 || (size_t) n >= sizeof(file_path))
+            continue;
+
+        n = snprintf(file_id, sizeof(file_id), "%s%s", id, entry->d_name);
+        if (n < 0 || (size_t) n >= sizeof(file_id))
+            continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            strcat(file_id, "-");
+            desktop_list_dir(list, file_path, file_id);
+        } else if (S_ISREG(st.st_mode) && has_suffix(file_id, ".desktop")) {
+            desktop_list_add(list, file_path, file_id, &st.st_mtim);
+        }
+    }
+
+    closedir(dir);
+}
+
+static int desktop_compare_id(const void *a, const void *b, void *arg)
+{
+    const struct desktop_file *files = arg;
+    size_t i = *(const size_t *) a, j = *(const size_t *) b;
+    int diff;
+
+    diff = strcmp(files[i].id, files[j].id);
+    if (diff)
+        return diff;
+
+    return (i > j) - (i < j);
+}
+
+static int desktop_compare_path(const void *a, const void *b)
+{
+    const struct desktop_file *x = a, *y = b;
+
+    return strcmp(x->path, y->path);
+}
+
+/*
+ * An entry in an earlier data directory hides all entries with the same ID
+ * in later directories.
+ */
+static size_t desktop_remove_hidden(struct desktop_file *files, size_t n)
+{
+    struct desktop_file *tmp;
+    size_t *index, n_keep = 0;
+
+    if (!n)
+        return 0;
+
+    index = malloc(n * sizeof(*index));
+    tmp = malloc(n * sizeof(*tmp));
+    if (!index || !tmp)
+        die("Out of memory\n");
+
+    for (size_t i = 0; i < n; ++i)
+        index[i] = i;
+
+    qsort_r(index, n, sizeof(*index), &desktop_compare_id, files);
+
+    for (size_t i = 0; i < n; ++i) {
+        const struct desktop_file *file = &files[index[i]];
+
+        if (n_keep && strcmp(tmp[n_keep - 1].id, file->id) == 0)
+            continue;
+
+        tmp[n_keep++] = *file;
+    }
+
+    memcpy(files, tmp, n_keep * sizeof(*files));
+
+    free(tmp);
+    free(index);
+
+    return n_keep;
+}
+
+/*
+ * Find the desktop entries of all applications in the colon separated list
+ * of XDG data directories. The returned list is sorted by path and all
+ * strings are allocated from 'arena'.
+ */
+size_t desktop_list_files(const char *data_dirs,
+                          struct desktop_file **files,
+                          struct arena *arena)
+{
+    struct desktop_list list;
+    char *iter, *dir;
+
+    list.files = NULL;
+    list.n = 0;
+    list.n_max = 0;
+    list.arena = arena;
+
+    iter = strdupa(data_dirs);
+
+    while ((dir = strsep(&iter, ":"))) {
+        char path[PATH_MAX];
+        int n;
+
+        /* Relative paths are invalid according to the specification */
+        if (dir[0] != '/')
+            continue;
+
+        n = snprintf(path, sizeof(path), "%s/applications", dir);
+        if (n < 0 || (size_t) n >= sizeof(path))
+            continue;
+
+        desktop_list_dir(&list, path, "");
+    }
+
+    list.n = desktop_remove_hidden(list.files, list.n);
+
+    if (list.n)
+        qsort(list.files, list.n, sizeof(*list.files), &desktop_compare_path);
+
+    *files = list.files;
+
+    return list.n;
+}
+
+static char *desktop_read(const char *path)
+{
+    struct stat st;
+    size_t size = 0;
+    char *buf = NULL;
+    int fd, err;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    err = fstat(fd, &st);
+    if (err < 0 || st.st_size > DESKTOP_MAX_FILE_SIZE)
+        goto out;
+
+    buf = malloc((size_t) st.st_size + 1);
+    if (!buf)
+        die("Out of memory\n");
+
+    while (size < (size_t) st.st_size) {
+        ssize_t n = read(fd, buf + size, (size_t) st.st_size - size);
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0)
+            break;
+
+        size += (size_t) n;
+    }
+
+    buf[size] = '\0';
+
+out:
+    close(fd);
+
+    return buf;
+}
+
+/*
+ * Resolve the escape sequences of a string value. The quoting rules of the
+ * "Exec" key are applied after this, so unknown sequences like "\\"" or
+ * "\\$" are kept for them if 'keep' is set.
+ */
+static void desktop_unescape(char *str, bool keep)
+{
+    char *dst = str;
+
+    for (const char *src = str; *src != '\0'; ++src) {
+        if (*src != '\\' || src[1] == '\0') {
+            *dst++ = *src;
+            continue;
+        }
+
+        switch (*++src) {
+        case 's':
+            *dst++ = ' ';
+            break;
+        case 'n':
+            *dst++ = '\n';
+            break;
+        case 't':
+            *dst++ = '\t';
+            break;
+        case 'r':
+            *dst++ = '\r';
+            break;
+        case '\\':
+            *dst++ = '\\';
+            break;
+        default:
+            if (keep)
+                *dst++ = '\\';
+
+            *dst++ = *src;
+            break;
+        }
+    }
+
+    *dst = '\0';
+}
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n';
+}
+
+/*
+ * Split the command line of an "Exec" key into the argument vector 'argv'
+ * with the strings stored in 'buf', which both have to be large enough.
+ * Arguments are separated by spaces and may be quoted with double quotes,
+ * in which '"', '`', '$' and '\\' are escaped by a backslash. Field codes
+ * like "%f" or "%U" are expanded by launchers which pass files or URLs to
+ * an application. wlmenu never does, so they are removed along with the
+ * arguments consisting only of them. Returns the number of arguments or 0
+ * if the command line is invalid.
+ */
+static size_t desktop_split_exec(const char *exec, char **argv, char *buf)
+{
+    const char *p = exec;
+    char *dst = buf;
+    size_t n = 0;
+
+    while (1) {
+        bool quoted = false, codes_only = true;
+        char *arg = dst;
+
+        while (is_space(*p))
+            ++p;
+
+        if (*p == '\0')
+            break;
+
+        while (*p != '\0' && (quoted || !is_space(*p))) {
+            if (*p == '"') {
+                quoted = !quoted;
+                codes_only = false;
+                ++p;
+                continue;
+            }
+
+            if (*p == '\\' && p[1] != '\0') {
+                /* Outside of quotes, the escaped character is taken as is */
+                if (!quoted || strchr("\"`$\\", p[1]))
+                    ++p;
+            } else if (*p == '%' && !quoted && p[1] != '%' && p[1] != '\0') {
+                p += 2;
+                continue;
+            } else if (*p == '%' && !quoted && p[1] == '%') {
+                ++p;
+            }
+
+            *dst++ = *p++;
+            codes_only = false;
+        }
+
+        if (quoted)
+            return 0;
+
+        if (codes_only) {
+            dst = arg;
+            continue;
+        }
+
+        *dst++ = '\0';
+        argv[n++] = arg;
+    }
+
+    argv[n] = NULL;
+
+    return n;
+}
+
+/*
+ * Turn the command line of an "Exec" key into an argument vector for
+ * execvp(). The vector and its strings are one allocation, which the caller
+ * releases with free(). Returns NULL if the command line is invalid.
+ */
+char **desktop_exec_argv(const char *exec)
+{
+    size_t len = strlen(exec);
+    char **argv, *buf;
+
+    /* Every argument takes at least two characters including its separator */
+    argv = malloc((len / 2 + 2) * sizeof(*argv) + len + 1);
+    if (!argv)
+        die("Out of memory\n");
+
+    buf = (char *) (argv + len / 2 + 2);
+
+    if (!desktop_split_exec(exec, argv, buf)) {
+        free(argv);
+        return NULL;
+    }
+
+    return argv;
+}
+
+static char *strip(char *str)
+{
+    char *end;
+
+    while (*str == ' ' || *str == '\t')
+        ++str;
+
+    end = str + strlen(str);
+
+    while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        --end;
+
+    *end = '\0';
+
+    return str;
+}
+
+/*
+ * Parse the "Desktop Entry" group of the file. The file is read into
+ * 'file->buf' and the values are split up in place. This function only
+ * touches 'file', so entries can be parsed concurrently.
+ */
+void desktop_parse(struct desktop_file *file)
+{
+    bool group = false, application = false, hidden = false;
+    char *iter, *line, **argv;
+
+    file->name = NULL;
+    file->exec = NULL;
+    file->try_exec = NULL;
+
+    file->buf = desktop_read(file->path);
+    if (!file->buf)
+        return;
+
+    iter = file->buf;
+
+    while ((line = strsep(&iter, "\n"))) {
+        char *key, *value;
+
+        line = strip(line);
+
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        /* "Desktop Entry" has to be the first group of the file */
+        if (line[0] == '[') {
+            if (group || strcmp(line, "[Desktop Entry]") != 0)
+                break;
+
+            group = true;
+            continue;
+        }
+
+        value = strchr(line, '=');
+        if (!group || !value)
+            continue;
+
+        *value++ = '\0';
+
+        key = strip(line);
+        value = strip(value);
+
+        if (strcmp(key, "Type") == 0) {
+            application = (strcmp(value, "Application") == 0);
+        } else if (strcmp(key, "Name") == 0) {
+            desktop_unescape(value, false);
+            file->name = value;
+        } else if (strcmp(key, "Exec") == 0) {
+            desktop_unescape(value, true);
+            file->exec = value;
+        } else if (strcmp(key, "TryExec") == 0) {
+            desktop_unescape(value, false);
+            file->try_exec = value;
+        } else if (strcmp(key, "NoDisplay") == 0) {
+            hidden |= (strcmp(value, "true") == 0);
+        } else if (strcmp(key, "Hidden") == 0) {
+            hidden |= (strcmp(value, "true") == 0);
+        }
+    }
+
+    if (!application || hidden || !file->name || !file->exec)
+        goto invalid;
+
+    if (file->name[0] == '\0')
+        goto invalid;
+
+    argv = desktop_exec_argv(file->exec);
+    if (!argv)
+        goto invalid;
+
+    free(argv);
+
+    return;
+
+invalid:
+    file->name = NULL;
+    file->exec = NULL;
+    file->try_exec = NULL;
+}
+
+static char *arena_strdup_null(struct arena *a, const char *str)
+{
+    return (str) ? arena_strdup(a, str) : NULL;
+}
+
+/* Move the parsed strings of 'file' into 'arena' and release its buffer */
+void desktop_keep(struct desktop_file *file, struct arena *arena)
+{
+    file->name = arena_strdup_null(arena, file->name);
+    file->exec = arena_strdup_null(arena, file->exec);
+    file->try_exec = arena_strdup_null(arena, file->try_exec);
+
+    free(file->buf);
+    file->buf = NULL;
+}
+
+static bool is_executable(const char *file, const char *path)
+{
+    size_t len = strlen(file);
+
+    if (strchr(file, '/'))
+        return access(file, X_OK) == 0;
+
+    while (*path != '\0') {
+        const char *end = strchrnul(path, ':');
+        size_t n = (size_t) (end - path);
+        char buf[PATH_MAX];
+
+        if (n && n + len + 2 <= sizeof(buf)) {
+            memcpy(buf, path, n);
+            buf[n] = '/';
+            memcpy(buf + n + 1, file, len + 1);
+
+            if (access(buf, X_OK) == 0)
+                return true;
+        }
+
+        path = (*end == ':') ? end + 1 : end;
+    }
+
+    return false;
+}
+
+/*
+ * An application with a "TryExec" key is only shown if the given program
+ * is installed, i.e. can be found in 'path'.
+ */
+bool desktop_is_item(const struct desktop_file *file, const char *path)
+{
+    if (!file->name)
+        return false;
+
+    return !file->try_exec || is_executable(file->try_exec, path);
+}
+
+static int desktop_compare_name(const void *a, const void *b, void *arg)
+{
+    const struct desktop_file *files = arg;
+    size_t i = *(const size_t *) a, j = *(const size_t *) b;
+    int diff;
+
+    diff = strcmp(files[i].name, files[j].name);
+    if (diff)
+        return diff;
+
+    return (i > j) - (i < j);
+}
+
+static char *desktop_id_label(const struct desktop_file *file,
+                              struct arena *arena)
+{
+    size_t len = strlen(file->id) - (sizeof(".desktop") - 1);
+    char *label;
+    int n;
+
+    n = snprintf(NULL, 0, "%s (%.*s)", file->name, (int) len, file->id);
+    if (n < 0)
+        die("Out of memory\n");
+
+    label = arena_alloc(arena, (size_t) n + 1);
+    sprintf(label, "%s (%.*s)", file->name, (int) len, file->id);
+
+    return label;
+}
+
+/*
+ * Applications may share a name, e.g. two terminals called "Terminal".
+ * Items are identified by their name, so such entries are labeled with
+ * their desktop file ID instead, e.g. "Terminal (org.gnome.Terminal)".
+ * All other entries are labeled with their name.
+ */
+void desktop_set_labels(struct desktop_file *files,
+                        size_t n,
+                        struct arena *arena)
+{
+    size_t *index, n_shown = 0;
+
+    index = malloc((n ? n : 1) * sizeof(*index));
+    if (!index)
+        die("Out of memory\n");
+
+    for (size_t i = 0; i < n; ++i) {
+        files[i].label = files[i].name;
+
+        if (files[i].shown)
+            index[n_shown++] = i;
+    }
+
+    qsort_r(index, n_shown, sizeof(*index), &desktop_compare_name, files);
+
+    for (size_t i = 0; i < n_shown;) {
+        size_t j = i + 1;
+
+        while (j < n_shown
+               && strcmp(files[index[i]].name, files[index[j]].name) == 0)
+            ++j;
+
+        if (j - i > 1) {
+            for (size_t k = i; k < j; ++k) {
+                struct desktop_file *file = &files[index[k]];
+
+                file->label = desktop_id_label(file, arena);
+            }
+        }
+
+        i = j;
+    }
+
+    free(index);
+}
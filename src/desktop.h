@@ -0,0 +1,73 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DESKTOP_H_
+#define DESKTOP_H_
+
+#include <stdbool.h>
+#include <time.h>
+
+#include "arena.h"
+
+/* An XDG desktop entry ("*.desktop" file) of an application */
+struct desktop_file {
+    char *path;
+    char *id;
+    struct timespec mtime;
+
+    /* The entry was taken from a still valid segment of the cache */
+    bool cached;
+
+    /* The entry provides an item which is shown in the menu */
+    bool shown;
+
+    /* Only set if the entry describes an application that can be shown */
+    char *name;
+    char *exec;
+    char *try_exec;
+
+    /* Name of the item in the menu, unique among all shown entries */
+    char *label;
+
+    /* Contents of the file as long as the above strings point into it */
+    char *buf;
+};
+
+size_t desktop_list_files(const char *data_dirs,
+                          struct desktop_file **files,
+                          struct arena *arena);
+
+void desktop_parse(struct desktop_file *file);
+
+void desktop_keep(struct desktop_file *file, struct arena *arena);
+
+bool desktop_is_item(const struct desktop_file *file, const char *path);
+
+void desktop_set_labels(struct desktop_file *files,
+                        size_t n,
+                        struct arena *arena);
+
+char **desktop_exec_argv(const char *exec);
+
+#endif /* DESKTOP_H_ */
@@ -0,0 +1,1005 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "proc-util.h"
+
+#include "dfa.h"
+#include "utf8.h"
+
+/* Limit of nested groups, which are parsed recursively */
+#define DFA_MAX_DEPTH 64
+
+/*
+ * Limit of cached states. Once it is reached, the remaining input of a
+ * string is matched by simulating the NFA instead.
+ */
+#define DFA_MAX_STATES 4096
+#define DFA_BLOCK_SIZE 64
+#define DFA_TABLE_SIZE (2 * DFA_MAX_STATES)
+
+#define DFA_UNKNOWN -1
+#define DFA_MAX_CHAR 0x10ffff
+
+enum dfa_op {
+    /* Consume one byte in the range ['lo', 'hi'] */
+    DFA_RANGE,
+    /* Continue at both 'out' and 'out1' */
+    DFA_SPLIT,
+    DFA_EMPTY,
+    /* Only continue at the start or the end of the string */
+    DFA_BOL,
+    DFA_EOL,
+    DFA_MATCH,
+};
+
+/* Node of the NFA, built from the expression by Thompson's construction */
+struct dfa_node {
+    enum dfa_op op;
+    unsigned char lo;
+    unsigned char hi;
+    int out;
+    int out1;
+};
+
+/*
+ * A state of the DFA stands for the set of NFA nodes the string can be in.
+ * Its transitions are filled in on first use and never change afterwards,
+ * so they are read without holding the mutex.
+ */
+struct dfa_state {
+    atomic_int next[256];
+
+    int *set;
+    size_t n;
+
+    bool accept;
+    bool accept_end;
+};
+
+struct dfa {
+    struct dfa_node *nodes;
+    size_t n_nodes;
+    size_t n_max;
+
+    int start;
+    int match;
+    bool accept_empty;
+
+    /* Guards everything below but the transitions of the states */
+    pthread_mutex_t mutex;
+
+    /* States never move, so a published state stays valid */
+    struct dfa_state *blocks[DFA_MAX_STATES / DFA_BLOCK_SIZE];
+    size_t n_states;
+    int initial;
+
+    /* Open addressing hash table of the states by their sets */
+    int *table;
+
+    /* Scratch space of the subset construction */
+    int *stack;
+    int *set;
+    int *alt;
+    unsigned int *marks;
+    unsigned int mark;
+};
+
+/*
+ * Fragment of the NFA under construction. The outputs of its nodes which
+ * are not connected yet form a list through the slots themselves, a slot
+ * being identified by 2 * node + 1 for 'out1' and 2 * node for 'out'.
+ */
+struct dfa_frag {
+    int start;
+    int tail;
+};
+
+struct dfa_range {
+    uint32_t lo;
+    uint32_t hi;
+};
+
+/* Set of characters matched by one atom of the expression */
+struct dfa_class {
+    struct dfa_range *ranges;
+    size_t n;
+    size_t n_max;
+};
+
+struct dfa_parser {
+    struct dfa *d;
+    const char *str;
+    const char *end;
+    int depth;
+};
+
+static struct dfa_state *dfa_state(const struct dfa *d, int id)
+{
+    return &d->blocks[id / DFA_BLOCK_SIZE][id % DFA_BLOCK_SIZE];
+}
+
+static int dfa_node(struct dfa *d, enum dfa_op op, int out, int out1)
+{
+    struct dfa_node *node;
+
+    if (d->n_nodes == d->n_max) {
+        d->n_max = (d->n_max) ? d->n_max * 2 : 64;
+
+        d->nodes = realloc(d->nodes, d->n_max * sizeof(*d->nodes));
+        if (!d->nodes)
+            die("Out of memory\n");
+    }
+
+    node = &d->nodes[d->n_nodes];
+    node->op = op;
+    node->lo = 0;
+    node->hi = 0;
+    node->out = out;
+    node->out1 = out1;
+
+    return (int) d->n_nodes++;
+}
+
+static int *dfa_slot(struct dfa *d, int slot)
+{
+    struct dfa_node *node = &d->nodes[slot / 2];
+
+    return (slot % 2) ? &node->out1 : &node->out;
+}
+
+/* Connect all slots of the list 'tail' to 'node' */
+static void dfa_patch(struct dfa *d, int tail, int node)
+{
+    while (tail >= 0) {
+        int *slot = dfa_slot(d, tail);
+
+        tail = *slot;
+        *slot = node;
+    }
+}
+
+static int dfa_append(struct dfa *d, int a, int b)
+{
+    int tail = a;
+
+    while (*dfa_slot(d, tail) >= 0)
+        tail = *dfa_slot(d, tail);
+
+    *dfa_slot(d, tail) = b;
+
+    return a;
+}
+
+static struct dfa_frag dfa_single(struct dfa *d, enum dfa_op op)
+{
+    int node = dfa_node(d, op, -1, -1);
+
+    return (struct dfa_frag) { node, 2 * node };
+}
+
+static struct dfa_frag
+dfa_bytes(struct dfa *d, unsigned char lo, unsigned char hi)
+{
+    struct dfa_frag f = dfa_single(d, DFA_RANGE);
+
+    d->nodes[f.start].lo = lo;
+    d->nodes[f.start].hi = hi;
+
+    return f;
+}
+
+static struct dfa_frag
+dfa_concat(struct dfa *d, struct dfa_frag a, struct dfa_frag b)
+{
+    dfa_patch(d, a.tail, b.start);
+
+    return (struct dfa_frag) { a.start, b.tail };
+}
+
+static struct dfa_frag
+dfa_alternate(struct dfa *d, struct dfa_frag a, struct dfa_frag b)
+{
+    int node = dfa_node(d, DFA_SPLIT, a.start, b.start);
+
+    return (struct dfa_frag) { node, dfa_append(d, a.tail, b.tail) };
+}
+
+static struct dfa_frag dfa_repeat(struct dfa *d, struct dfa_frag f, char op)
+{
+    int node = dfa_node(d, DFA_SPLIT, f.start, -1);
+
+    switch (op) {
+    case '*':
+        dfa_patch(d, f.tail, node);
+        return (struct dfa_frag) { node, 2 * node + 1 };
+    case '+':
+        dfa_patch(d, f.tail, node);
+        return (struct dfa_frag) { f.start, 2 * node + 1 };
+    default:
+        return (struct dfa_frag) { node, dfa_append(d, f.tail, 2 * node + 1) };
+    }
+}
+
+static size_t dfa_encode(uint32_t c, unsigned char *buf)
+{
+    if (c < 0x80) {
+        buf[0] = (unsigned char) c;
+        return 1;
+    }
+
+    if (c < 0x800) {
+        buf[0] = (unsigned char) (0xc0 | c >> 6);
+        buf[1] = (unsigned char) (0x80 | (c & 0x3f));
+        return 2;
+    }
+
+    if (c < 0x10000) {
+        buf[0] = (unsigned char) (0xe0 | c >> 12);
+        buf[1] = (unsigned char) (0x80 | (c >> 6 & 0x3f));
+        buf[2] = (unsigned char) (0x80 | (c & 0x3f));
+        return 3;
+    }
+
+    buf[0] = (unsigned char) (0xf0 | c >> 18);
+    buf[1] = (unsigned char) (0x80 | (c >> 12 & 0x3f));
+    buf[2] = (unsigned char) (0x80 | (c >> 6 & 0x3f));
+    buf[3] = (unsigned char) (0x80 | (c & 0x3f));
+    return 4;
+}
+
+/*
+ * Byte sequences of the characters in [lo, hi], which all have to be
+ * encoded with the same number of bytes. The range is split until every
+ * byte of the sequences can take its values independently of the others.
+ */
+static struct dfa_frag dfa_utf8_range(struct dfa *d, uint32_t lo, uint32_t hi)
+{
+    unsigned char a[4], b[4];
+    struct dfa_frag f;
+    size_t n = dfa_encode(lo, a);
+
+    for (size_t i = 1; i < n; ++i) {
+        uint32_t m = (UINT32_C(1) << (6 * i)) - 1;
+
+        if ((lo & ~m) == (hi & ~m))
+            continue;
+
+        if (lo & m) {
+            return dfa_alternate(d,
+                                 dfa_utf8_range(d, lo, lo | m),
+                                 dfa_utf8_range(d, (lo | m) + 1, hi));
+        }
+
+        if ((hi & m) != m) {
+            return dfa_alternate(d,
+                                 dfa_utf8_range(d, lo, (hi & ~m) - 1),
+                                 dfa_utf8_range(d, hi & ~m, hi));
+        }
+    }
+
+    dfa_encode(hi, b);
+
+    f = dfa_bytes(d, a[0], b[0]);
+
+    for (size_t i = 1; i < n; ++i)
+        f = dfa_concat(d, f, dfa_bytes(d, a[i], b[i]));
+
+    return f;
+}
+
+static struct dfa_frag dfa_class_frag(struct dfa *d, const struct dfa_class *c)
+{
+    static const uint32_t bounds[] = { 0x7f, 0x7ff, 0xffff, DFA_MAX_CHAR };
+    struct dfa_frag f = { -1, -1 };
+
+    for (size_t i = 0; i < c->n; ++i) {
+        uint32_t lo = c->ranges[i].lo;
+
+        for (size_t j = 0; j < 4 && lo <= c->ranges[i].hi; ++j) {
+            uint32_t hi = c->ranges[i].hi;
+            struct dfa_frag next;
+
+            if (lo > bounds[j])
+                continue;
+
+            if (hi > bounds[j])
+                hi = bounds[j];
+
+            next = dfa_utf8_range(d, lo, hi);
+            f = (f.start < 0) ? next : dfa_alternate(d, f, next);
+            lo = hi + 1;
+        }
+    }
+
+    /* An empty class never matches */
+    return (f.start < 0) ? dfa_bytes(d, 1, 0) : f;
+}
+
+static void dfa_class_add(struct dfa_class *c, uint32_t lo, uint32_t hi)
+{
+    if (c->n == c->n_max) {
+        c->n_max = (c->n_max) ? c->n_max * 2 : 8;
+
+        c->ranges = realloc(c->ranges, c->n_max * sizeof(*c->ranges));
+        if (!c->ranges)
+            die("Out of memory\n");
+    }
+
+    c->ranges[c->n].lo = lo;
+    c->ranges[c->n].hi = hi;
+    ++c->n;
+}
+
+static int dfa_range_compare(const void *a, const void *b)
+{
+    const struct dfa_range *x = a, *y = b;
+
+    return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+/* Replace the characters of 'c' by all others but NUL */
+static void dfa_class_negate(struct dfa_class *c)
+{
+    struct dfa_class neg = { NULL, 0, 0 };
+    uint32_t lo = 1;
+
+    qsort(c->ranges, c->n, sizeof(*c->ranges), &dfa_range_compare);
+
+    for (size_t i = 0; i < c->n; ++i) {
+        if (c->ranges[i].lo > lo)
+            dfa_class_add(&neg, lo, c->ranges[i].lo - 1);
+
+        if (c->ranges[i].hi >= lo)
+            lo = c->ranges[i].hi + 1;
+    }
+
+    if (lo <= DFA_MAX_CHAR)
+        dfa_class_add(&neg, lo, DFA_MAX_CHAR);
+
+    free(c->ranges);
+    *c = neg;
+}
+
+static bool dfa_next_char(struct dfa_parser *p, uint32_t *c)
+{
+    size_t n = utf8_decode(p->str, (size_t) (p->end - p->str), c);
+
+    p->str += n;
+
+    return n && *c;
+}
+
+static bool dfa_is_alnum(uint32_t c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')
+           || (c >= 'A' && c <= 'Z');
+}
+
+/* Add the characters of 'src' to 'dst', or all others if 'negate' is set */
+static void
+dfa_class_merge(struct dfa_class *dst, struct dfa_class *src, bool negate)
+{
+    if (negate)
+        dfa_class_negate(src);
+
+    for (size_t i = 0; i < src->n; ++i)
+        dfa_class_add(dst, src->ranges[i].lo, src->ranges[i].hi);
+
+    free(src->ranges);
+}
+
+/*
+ * The pattern is folded except for its escapes, so the upper case ones
+ * still stand for the negated classes.
+ */
+static bool dfa_parse_escape(struct dfa_parser *p, struct dfa_class *c)
+{
+    struct dfa_class tmp = { NULL, 0, 0 };
+    uint32_t ch;
+
+    if (p->str == p->end || !dfa_next_char(p, &ch))
+        return false;
+
+    switch (ch) {
+    case 'd':
+    case 'D':
+        dfa_class_add(&tmp, '0', '9');
+        break;
+    case 'w':
+    case 'W':
+        dfa_class_add(&tmp, '0', '9');
+        dfa_class_add(&tmp, 'a', 'z');
+        dfa_class_add(&tmp, '_', '_');
+        break;
+    case 's':
+    case 'S':
+        dfa_class_add(&tmp, ' ', ' ');
+        dfa_class_add(&tmp, '\t', '\t');
+        break;
+    case 't':
+        dfa_class_add(&tmp, '\t', '\t');
+        break;
+    default:
+        if (dfa_is_alnum(ch))
+            return false;
+
+        dfa_class_add(&tmp, ch, ch);
+        break;
+    }
+
+    dfa_class_merge(c, &tmp, ch == 'D' || ch == 'W' || ch == 'S');
+
+    return true;
+}
+
+static bool dfa_parse_bracket(struct dfa_parser *p, struct dfa_class *c)
+{
+    bool negate = false, first = true;
+
+    if (p->str < p->end && *p->str == '^') {
+        negate = true;
+        ++p->str;
+    }
+
+    while (1) {
+        uint32_t lo, hi;
+
+        if (p->str == p->end)
+            return false;
+
+        /* A ']' right at the start is taken literally */
+        if (*p->str == ']' && !first) {
+            ++p->str;
+            break;
+        }
+
+        first = false;
+
+        if (*p->str == '\\') {
+            ++p->str;
+
+            if (!dfa_parse_escape(p, c))
+                return false;
+
+            continue;
+        }
+
+        if (!dfa_next_char(p, &lo))
+            return false;
+
+        hi = lo;
+
+        if (p->end - p->str >= 2 && p->str[0] == '-' && p->str[1] != ']') {
+            ++p->str;
+
+            if (!dfa_next_char(p, &hi) || hi < lo)
+                return false;
+        }
+
+        dfa_class_add(c, lo, hi);
+    }
+
+    if (negate)
+        dfa_class_negate(c);
+
+    return true;
+}
+
+static bool dfa_parse_alternation(struct dfa_parser *p, struct dfa_frag *f);
+
+static bool dfa_parse_atom(struct dfa_parser *p, struct dfa_frag *f)
+{
+    struct dfa_class c = { NULL, 0, 0 };
+    uint32_t ch;
+    bool ok;
+
+    switch (*p->str) {
+    case '(':
+        ++p->str;
+
+        if (++p->depth > DFA_MAX_DEPTH || !dfa_parse_alternation(p, f))
+            return false;
+
+        if (p->str == p->end || *p->str != ')')
+            return false;
+
+        ++p->str;
+        --p->depth;
+        return true;
+    case '^':
+        ++p->str;
+        *f = dfa_single(p->d, DFA_BOL);
+        return true;
+    case '$':
+        ++p->str;
+        *f = dfa_single(p->d, DFA_EOL);
+        return true;
+    case '*':
+    case '+':
+    case '?':
+        return false;
+    case '.':
+        ++p->str;
+        dfa_class_add(&c, 1, DFA_MAX_CHAR);
+        ok = true;
+        break;
+    case '[':
+        ++p->str;
+        ok = dfa_parse_bracket(p, &c);
+        break;
+    case '\\':
+        ++p->str;
+        ok = dfa_parse_escape(p, &c);
+        break;
+    default:
+        ok = dfa_next_char(p, &ch);
+        if (ok)
+            dfa_class_add(&c, ch, ch);
+        break;
+    }
+
+    if (ok)
+        *f = dfa_class_frag(p->d, &c);
+
+    free(c.ranges);
+
+    return ok;
+}
+
+static bool dfa_is_repeat(char c)
+{
+    return c == '*' || c == '+' || c == '?';
+}
+
+static bool dfa_parse_concat(struct dfa_parser *p, struct dfa_frag *f)
+{
+    *f = dfa_single(p->d, DFA_EMPTY);
+
+    while (p->str < p->end && *p->str != '|' && *p->str != ')') {
+        struct dfa_frag atom;
+
+        if (!dfa_parse_atom(p, &atom))
+            return false;
+
+        while (p->str < p->end && dfa_is_repeat(*p->str))
+            atom = dfa_repeat(p->d, atom, *p->str++);
+
+        *f = dfa_concat(p->d, *f, atom);
+    }
+
+    return true;
+}
+
+static bool dfa_parse_alternation(struct dfa_parser *p, struct dfa_frag *f)
+{
+    if (!dfa_parse_concat(p, f))
+        return false;
+
+    while (p->str < p->end && *p->str == '|') {
+        struct dfa_frag next;
+
+        ++p->str;
+
+        if (!dfa_parse_concat(p, &next))
+            return false;
+
+        *f = dfa_alternate(p->d, *f, next);
+    }
+
+    return true;
+}
+
+static void dfa_new_mark(struct dfa *d)
+{
+    if (++d->mark == 0) {
+        memset(d->marks, 0, d->n_nodes * sizeof(*d->marks));
+        d->mark = 1;
+    }
+}
+
+static void dfa_push(struct dfa *d, int node, size_t *top)
+{
+    if (d->marks[node] == d->mark)
+        return;
+
+    d->marks[node] = d->mark;
+    d->stack[(*top)++] = node;
+}
+
+/*
+ * Add the nodes reachable from 'node' without consuming a byte to 'set'.
+ * Only nodes which consume a byte or have to wait for the end of the
+ * string end up in there, besides the final one.
+ */
+static void
+dfa_closure(struct dfa *d, int node, bool bol, int *set, size_t *n)
+{
+    size_t top = 0;
+
+    dfa_push(d, node, &top);
+
+    while (top) {
+        const struct dfa_node *x;
+        int i = d->stack[--top];
+
+        x = &d->nodes[i];
+
+        switch (x->op) {
+        case DFA_SPLIT:
+            dfa_push(d, x->out1, &top);
+            dfa_push(d, x->out, &top);
+            break;
+        case DFA_EMPTY:
+            dfa_push(d, x->out, &top);
+            break;
+        case DFA_BOL:
+            if (bol)
+                dfa_push(d, x->out, &top);
+            break;
+        default:
+            set[(*n)++] = i;
+            break;
+        }
+    }
+}
+
+/*
+ * Whether the end of the string completes a match from 'set'. It may also
+ * be the start of the string if 'bol' is set.
+ */
+static bool
+dfa_accepts_at_end(struct dfa *d, const int *set, size_t n, bool bol)
+{
+    size_t top = 0;
+
+    dfa_new_mark(d);
+
+    for (size_t i = 0; i < n; ++i) {
+        if (set[i] == d->match)
+            return true;
+
+        if (d->nodes[set[i]].op == DFA_EOL)
+            dfa_push(d, d->nodes[set[i]].out, &top);
+    }
+
+    while (top) {
+        const struct dfa_node *x = &d->nodes[d->stack[--top]];
+
+        switch (x->op) {
+        case DFA_SPLIT:
+            dfa_push(d, x->out1, &top);
+            dfa_push(d, x->out, &top);
+            break;
+        case DFA_EMPTY:
+        case DFA_EOL:
+            dfa_push(d, x->out, &top);
+            break;
+        case DFA_BOL:
+            if (bol)
+                dfa_push(d, x->out, &top);
+            break;
+        case DFA_MATCH:
+            return true;
+        default:
+            break;
+        }
+    }
+
+    return false;
+}
+
+static bool dfa_has_match(const struct dfa *d, const int *set, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        if (set[i] == d->match)
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Collect the nodes reached from 'set' by consuming 'c' in 'next'. The
+ * expression is searched for anywhere in the string, so a new match may
+ * start behind every byte.
+ */
+static size_t dfa_advance(struct dfa *d,
+                          const int *set,
+                          size_t n,
+                          unsigned char c,
+                          int *next)
+{
+    size_t k = 0;
+
+    dfa_new_mark(d);
+
+    for (size_t i = 0; i < n; ++i) {
+        const struct dfa_node *x = &d->nodes[set[i]];
+
+        if (x->op == DFA_RANGE && c >= x->lo && c <= x->hi)
+            dfa_closure(d, x->out, false, next, &k);
+    }
+
+    dfa_closure(d, d->start, false, next, &k);
+
+    return k;
+}
+
+static int dfa_int_compare(const void *a, const void *b)
+{
+    int x = *(const int *) a, y = *(const int *) b;
+
+    return (x > y) - (x < y);
+}
+
+static size_t dfa_hash(const int *set, size_t n)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < n; ++i) {
+        hash ^= (uint32_t) set[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/* Look up the state of 'set' or add it, unless the cache is full */
+static int dfa_add_state(struct dfa *d, int *set, size_t n)
+{
+    struct dfa_state *s;
+    size_t i;
+    int id;
+
+    qsort(set, n, sizeof(*set), &dfa_int_compare);
+
+    i = dfa_hash(set, n) % DFA_TABLE_SIZE;
+
+    while ((id = d->table[i]) >= 0) {
+        s = dfa_state(d, id);
+
+        if (s->n == n && memcmp(s->set, set, n * sizeof(*set)) == 0)
+            return id;
+
+        i = (i + 1) % DFA_TABLE_SIZE;
+    }
+
+    if (d->n_states == DFA_MAX_STATES)
+        return DFA_UNKNOWN;
+
+    id = (int) d->n_states;
+
+    if (d->n_states % DFA_BLOCK_SIZE == 0) {
+        struct dfa_state **block = &d->blocks[id / DFA_BLOCK_SIZE];
+
+        *block = malloc(DFA_BLOCK_SIZE * sizeof(**block));
+        if (!*block)
+            die("Out of memory\n");
+    }
+
+    s = dfa_state(d, id);
+
+    s->set = malloc((n ? n : 1) * sizeof(*s->set));
+    if (!s->set)
+        die("Out of memory\n");
+
+    memcpy(s->set, set, n * sizeof(*set));
+    s->n = n;
+    s->accept = dfa_has_match(d, set, n);
+    s->accept_end = dfa_accepts_at_end(d, set, n, false);
+
+    for (size_t c = 0; c < 256; ++c)
+        atomic_init(&s->next[c], DFA_UNKNOWN);
+
+    d->table[i] = id;
+    ++d->n_states;
+
+    return id;
+}
+
+static int dfa_step(struct dfa *d, struct dfa_state *s, unsigned char c)
+{
+    int id;
+
+    pthread_mutex_lock(&d->mutex);
+
+    /* Another thread may have added the transition in the meantime */
+    id = atomic_load_explicit(&s->next[c], memory_order_relaxed);
+
+    if (id == DFA_UNKNOWN) {
+        size_t n = dfa_advance(d, s->set, s->n, c, d->set);
+
+        id = dfa_add_state(d, d->set, n);
+        if (id != DFA_UNKNOWN)
+            atomic_store_explicit(&s->next[c], id, memory_order_release);
+    }
+
+    pthread_mutex_unlock(&d->mutex);
+
+    return id;
+}
+
+/* Match the rest of 'str' from 's' once no more states can be cached */
+static bool
+dfa_simulate(struct dfa *d, const struct dfa_state *s, const char *str)
+{
+    int *set, *next;
+    size_t n = s->n;
+    bool match = false;
+
+    pthread_mutex_lock(&d->mutex);
+
+    set = d->set;
+    next = d->alt;
+
+    memcpy(set, s->set, n * sizeof(*set));
+
+    for (; *str != '\0' && !match; ++str) {
+        int *tmp = set;
+
+        n = dfa_advance(d, set, n, (unsigned char) *str, next);
+        set = next;
+        next = tmp;
+
+        match = dfa_has_match(d, set, n);
+    }
+
+    if (!match)
+        match = dfa_accepts_at_end(d, set, n, false);
+
+    pthread_mutex_unlock(&d->mutex);
+
+    return match;
+}
+
+static void *dfa_alloc(size_t n, size_t size)
+{
+    void *mem = calloc(n, size);
+
+    if (!mem)
+        die("Out of memory\n");
+
+    return mem;
+}
+
+void dfa_fold(char *dst, const char *src, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len) {
+        size_t n = 0;
+
+        while (i + n < len && src[i + n] != '\\')
+            ++n;
+
+        utf8_fold(dst + i, src + i, n);
+        i += n;
+
+        if (i == len)
+            break;
+
+        /* The backslash and an escaped ASCII character are kept */
+        dst[i] = src[i];
+        ++i;
+
+        if (i < len && (unsigned char) src[i] < 0x80) {
+            dst[i] = src[i];
+            ++i;
+        }
+    }
+}
+
+/* Returns NULL if 'str' is not a valid expression */
+struct dfa *dfa_compile(const char *str, size_t len)
+{
+    struct dfa *d = dfa_alloc(1, sizeof(*d));
+    struct dfa_parser p = { d, str, str + len, 0 };
+    struct dfa_frag f;
+    size_t n;
+
+    pthread_mutex_init(&d->mutex, NULL);
+
+    if (!dfa_parse_alternation(&p, &f) || p.str != p.end) {
+        dfa_free(d);
+        return NULL;
+    }
+
+    d->match = dfa_node(d, DFA_MATCH, -1, -1);
+    dfa_patch(d, f.tail, d->match);
+    d->start = f.start;
+
+    d->table = malloc(DFA_TABLE_SIZE * sizeof(*d->table));
+    if (!d->table)
+        die("Out of memory\n");
+
+    memset(d->table, 0xff, DFA_TABLE_SIZE * sizeof(*d->table));
+
+    d->stack = dfa_alloc(d->n_nodes, sizeof(*d->stack));
+    d->set = dfa_alloc(d->n_nodes, sizeof(*d->set));
+    d->alt = dfa_alloc(d->n_nodes, sizeof(*d->alt));
+    d->marks = dfa_alloc(d->n_nodes, sizeof(*d->marks));
+
+    n = 0;
+    dfa_new_mark(d);
+    dfa_closure(d, d->start, true, d->set, &n);
+    d->initial = dfa_add_state(d, d->set, n);
+    d->accept_empty = dfa_accepts_at_end(d, d->set, n, true);
+
+    return d;
+}
+
+void dfa_free(struct dfa *d)
+{
+    if (!d)
+        return;
+
+    for (size_t i = 0; i < d->n_states; ++i)
+        free(dfa_state(d, (int) i)->set);
+
+    for (size_t i = 0; i * DFA_BLOCK_SIZE < d->n_states; ++i)
+        free(d->blocks[i]);
+
+    free(d->marks);
+    free(d->alt);
+    free(d->set);
+    free(d->stack);
+    free(d->table);
+    free(d->nodes);
+
+    pthread_mutex_destroy(&d->mutex);
+    free(d);
+}
+
+bool dfa_match(struct dfa *d, const char *str)
+{
+    struct dfa_state *s = dfa_state(d, d->initial);
+
+    if (*str == '\0')
+        return d->accept_empty;
+
+    for (; *str != '\0'; ++str) {
+        unsigned char c = (unsigned char) *str;
+        int next;
+
+        if (s->accept)
+            return true;
+
+        next = atomic_load_explicit(&s->next[c], memory_order_acquire);
+        if (next == DFA_UNKNOWN) {
+            next = dfa_step(d, s, c);
+            if (next == DFA_UNKNOWN)
+                return dfa_simulate(d, s, str);
+        }
+
+        s = dfa_state(d, next);
+    }
+
+    return s->accept || s->accept_end;
+}
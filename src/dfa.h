@@ -0,0 +1,58 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DFA_H_
+#define DFA_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Regular expression which is searched for anywhere in a string. It is
+ * matched by a DFA whose states are only built while strings are scanned
+ * and cached for all following ones, so every string takes one forward
+ * pass over its bytes without any backtracking. Several threads may match
+ * with the same DFA at once.
+ *
+ * Supported are literal characters, '.', bracket expressions with ranges
+ * and negation, the anchors '^' and '$', the repetitions '*', '+' and '?',
+ * alternation with '|', groups and the escapes \d, \w, \s, their negations
+ * \D, \W, \S and \t. Any other character which is not a letter or digit is
+ * taken literally when escaped.
+ */
+struct dfa;
+
+/*
+ * Fold 'len' bytes of the expression 'src' into 'dst' like utf8_fold(),
+ * but keep the case of the escapes. 'dst' may be the same as 'src'.
+ */
+void dfa_fold(char *dst, const char *src, size_t len);
+
+struct dfa *dfa_compile(const char *str, size_t len);
+
+void dfa_free(struct dfa *d);
+
+bool dfa_match(struct dfa *d, const char *str);
+
+#endif /* DFA_H_ */
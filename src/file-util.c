@@ -0,0 +1,145 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file-util.h"
+
+static int write_all(int fd, struct iovec *iov, int n)
+{
+    while (n) {
+        ssize_t size = writev(fd, iov, n);
+        if (size < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return -errno;
+        }
+
+        while (n && (size_t) size >= iov->iov_len) {
+            size -= iov->iov_len;
+            ++iov;
+            --n;
+        }
+
+        if (n) {
+            iov->iov_base = (char *) iov->iov_base + size;
+            iov->iov_len -= size;
+        }
+    }
+
+    return 0;
+}
+
+/* Create all missing parent directories of 'path' */
+int make_directories(const char *path, mode_t mode)
+{
+    char *dup = strdupa(path);
+
+    for (char *p = dup + 1; *p != '\0'; ++p) {
+        int err;
+
+        if (*p != '/' || p[-1] == '/')
+            continue;
+
+        *p = '\0';
+
+        err = mkdir(dup, mode);
+        if (err < 0 && errno != EEXIST)
+            return -errno;
+
+        *p = '/';
+    }
+
+    return 0;
+}
+
+/*
+ * Write the file 'path' with a single writev() call to a temporary file
+ * which then replaces 'path'. Readers either see the old or the new
+ * contents of the file, but never a partially written one.
+ */
+int write_file_atomic(const char *path, struct iovec *iov, int n)
+{
+    size_t len = strlen(path);
+    char *tmp = alloca(len + sizeof(".XXXXXX"));
+    int fd, err;
+
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".XXXXXX", sizeof(".XXXXXX"));
+
+    fd = mkostemp(tmp, O_CLOEXEC);
+    if (fd < 0 && errno == ENOENT) {
+        err = make_directories(path, 0755);
+        if (err < 0)
+            return err;
+
+        memcpy(tmp + len, ".XXXXXX", sizeof(".XXXXXX"));
+
+        fd = mkostemp(tmp, O_CLOEXEC);
+    }
+
+    if (fd < 0)
+        return -errno;
+
+    err = fchmod(fd, 0644);
+    if (err < 0) {
+        err = -errno;
+        goto fail;
+    }
+
+    err = write_all(fd, iov, n);
+    if (err < 0)
+        goto fail;
+
+    err = close(fd);
+    fd = -1;
+    if (err < 0) {
+        err = -errno;
+        goto fail;
+    }
+
+    err = rename(tmp, path);
+    if (err < 0) {
+        err = -errno;
+        goto fail;
+    }
+
+    return 0;
+
+fail:
+    if (fd >= 0)
+        close(fd);
+
+    unlink(tmp);
+
+    return err;
+}
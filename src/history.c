@@ -0,0 +1,319 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "file-util.h"
+#include "proc-util.h"
+
+#include "history.h"
+
+/*
+ * Layout of the history file:
+ *
+ *      struct history_header
+ *      struct history_entry entries[n_entries]
+ *      char blob[blob_size]
+ *
+ * The entries are sorted by the names they refer to, which are stored as
+ * null-terminated strings inside 'blob'. A file whose entries are out of
+ * order is rejected like any other broken file, since looking up names in
+ * it would silently yield wrong scores.
+ */
+
+#define HISTORY_MAGIC 0x54534948 /* "HIST" */
+#define HISTORY_VERSION 1
+
+/* Age in seconds after which a launch no longer counts */
+#define HISTORY_MAX_AGE (90 * 24 * 60 * 60)
+
+struct history_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_entries;
+    uint32_t blob_size;
+};
+
+struct history_entry {
+    int64_t last;
+    uint32_t name;
+    uint32_t count;
+};
+
+static bool history_check(struct history *h)
+{
+    const struct history_header *header = h->mem;
+    size_t n;
+
+    if (h->size < sizeof(*header))
+        return false;
+
+    if (header->magic != HISTORY_MAGIC || header->version != HISTORY_VERSION)
+        return false;
+
+    n = sizeof(*header) + header->n_entries * sizeof(*h->entries);
+
+    if (n + header->blob_size != h->size)
+        return false;
+
+    h->header = header;
+    h->entries = (const struct history_entry *) (header + 1);
+    h->blob = (const char *) (h->entries + header->n_entries);
+
+    if (header->blob_size && h->blob[header->blob_size - 1] != '\0')
+        return false;
+
+    for (uint32_t i = 0; i < header->n_entries; ++i) {
+        if (h->entries[i].name >= header->blob_size)
+            return false;
+    }
+
+    for (uint32_t i = 1; i < header->n_entries; ++i) {
+        const char *prev = h->blob + h->entries[i - 1].name;
+
+        if (strcmp(prev, h->blob + h->entries[i].name) >= 0)
+            return false;
+    }
+
+    return true;
+}
+
+static void history_reset(struct history *h)
+{
+    h->mem = NULL;
+    h->size = 0;
+    h->header = NULL;
+    h->entries = NULL;
+    h->blob = NULL;
+}
+
+/* A missing or broken history file is treated as an empty history */
+void history_open(struct history *h, const char *path)
+{
+    struct stat st;
+    int fd, err;
+
+    history_reset(h);
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    err = fstat(fd, &st);
+    if (err < 0 || !st.st_size)
+        goto out;
+
+    h->size = (size_t) st.st_size;
+
+    h->mem = mmap(NULL, h->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (h->mem == MAP_FAILED) {
+        history_reset(h);
+        goto out;
+    }
+
+    if (!history_check(h))
+        history_close(h);
+
+out:
+    close(fd);
+}
+
+void history_close(struct history *h)
+{
+    if (h->mem)
+        munmap(h->mem, h->size);
+
+    history_reset(h);
+}
+
+static size_t history_size(const struct history *h)
+{
+    return (h->header) ? h->header->n_entries : 0;
+}
+
+static const char *history_name(const struct history *h, size_t i)
+{
+    return h->blob + h->entries[i].name;
+}
+
+/* Index of the first entry whose name is not less than 'name' */
+static size_t history_find(const struct history *h, const char *name)
+{
+    size_t low = 0, high = history_size(h);
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if (strcmp(history_name(h, mid), name) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/*
+ * The frecency of an entry: Every launch counts more the more recently the
+ * item was used. Launches older than four weeks count half, rounded up so
+ * an item launched once is kept until HISTORY_MAX_AGE, and the ones older
+ * than that not at all.
+ */
+static uint32_t history_entry_score(const struct history_entry *entry,
+                                    time_t now)
+{
+    int64_t age = (int64_t) now - entry->last;
+    uint64_t score = entry->count;
+
+    if (age < 60 * 60)
+        score *= 8;
+    else if (age < 24 * 60 * 60)
+        score *= 4;
+    else if (age < 7 * 24 * 60 * 60)
+        score *= 2;
+    else if (age >= HISTORY_MAX_AGE)
+        score = 0;
+    else if (age >= 28 * 24 * 60 * 60)
+        score = (score + 1) / 2;
+
+    return (score < UINT32_MAX) ? (uint32_t) score : UINT32_MAX;
+}
+
+uint32_t history_score(const struct history *h, const char *name, time_t now)
+{
+    size_t i = history_find(h, name);
+
+    if (i >= history_size(h) || strcmp(history_name(h, i), name) != 0)
+        return 0;
+
+    return history_entry_score(&h->entries[i], now);
+}
+
+/* Store 'str' at 'blob' as the name of 'entry', 'base' is the start of it */
+static char *history_copy(struct history_entry *entry,
+                          char *blob,
+                          const char *base,
+                          const char *str)
+{
+    entry->name = (uint32_t) (blob - base);
+
+    return stpcpy(blob, str) + 1;
+}
+
+/*
+ * Write a new history file to 'path' in which the launch of 'name' at
+ * 'now' is recorded. Entries whose score decayed to zero are left out, so
+ * the file only holds recently launched items. The mapped
+ * history 'h' itself is not changed.
+ */
+int history_record(const struct history *h,
+                   const char *path,
+                   const char *name,
+                   time_t now)
+{
+    struct history_header *header;
+    struct history_entry *entries;
+    size_t n_old = history_size(h), n = 0, i, len, blob_size = 0;
+    bool found;
+    struct iovec iov;
+    char *mem, *blob, *base;
+    int err;
+
+    i = history_find(h, name);
+    found = i < n_old && strcmp(history_name(h, i), name) == 0;
+
+    for (size_t j = 0; j < n_old; ++j) {
+        if ((found && j == i) || history_entry_score(&h->entries[j], now)) {
+            blob_size += strlen(history_name(h, j)) + 1;
+            ++n;
+        }
+    }
+
+    if (!found) {
+        blob_size += strlen(name) + 1;
+        ++n;
+    }
+
+    if (blob_size > UINT32_MAX || n > UINT32_MAX)
+        return -EOVERFLOW;
+
+    len = sizeof(*header) + n * sizeof(*entries) + blob_size;
+
+    mem = malloc(len);
+    if (!mem)
+        die("Out of memory\n");
+
+    header = (struct history_header *) mem;
+    entries = (struct history_entry *) (header + 1);
+    blob = (char *) (entries + n);
+
+    header->magic = HISTORY_MAGIC;
+    header->version = HISTORY_VERSION;
+    header->n_entries = (uint32_t) n;
+    header->blob_size = (uint32_t) blob_size;
+
+    base = blob;
+    n = 0;
+
+    /* Copy the kept entries and insert the launched item in sorted order */
+    for (size_t j = 0; j <= n_old; ++j) {
+        if (j == i && !found) {
+            entries[n].last = now;
+            entries[n].count = 1;
+            blob = history_copy(&entries[n++], blob, base, name);
+        }
+
+        if (j == n_old)
+            break;
+
+        if (!(found && j == i) && !history_entry_score(&h->entries[j], now))
+            continue;
+
+        entries[n] = h->entries[j];
+
+        if (found && j == i) {
+            entries[n].last = now;
+            entries[n].count += (entries[n].count < UINT32_MAX);
+        }
+
+        blob = history_copy(&entries[n++], blob, base, history_name(h, j));
+    }
+
+    iov.iov_base = mem;
+    iov.iov_len = len;
+
+    err = write_file_atomic(path, &iov, 1);
+
+    free(mem);
+
+    return err;
+}
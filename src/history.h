@@ -0,0 +1,57 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Launch history of the items: How often each item was launched and when
+ * it was launched the last time. The history file is mapped read-only and
+ * replaced atomically whenever an item is launched.
+ */
+struct history {
+    void *mem;
+    size_t size;
+
+    const struct history_header *header;
+    const struct history_entry *entries;
+    const char *blob;
+};
+
+void history_open(struct history *h, const char *path);
+
+void history_close(struct history *h);
+
+uint32_t history_score(const struct history *h, const char *name, time_t now);
+
+int history_record(const struct history *h,
+                   const char *path,
+                   const char *name,
+                   time_t now);
+
+#endif /* HISTORY_H_ */
@@ -29,325 +29,1926 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <poll.h>
+#include <pthread.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#ifdef HAVE_IO_URING
+#include <liburing.h>
+#endif
+
+#include "arena.h"
+#include "desktop.h"
+#include "file-util.h"
+#include "pool.h"
+#include "prefix.h"
 #include "proc-util.h"
+#include "queue.h"
+#include "store.h"
+#include "trigram.h"
+
+#include "load.h"
+
+/*
+ * The item list is sorted in the order of strverscmp(): Runs of digits are
+ * compared by their numeric value, everything else byte by byte. A run with
+ * leading zeros is a fractional part that sorts before all other numbers.
+ * Such runs are compared digit by digit, except that a run of only zeros
+ * sorts after all runs which continue with more digits, i.e.
+ *
+ *      000 < 00 < 01 < 010 < 09 < 0 < 1 < 9 < 10
+ *
+ * Instead of parsing the digit runs on every comparison, every name is
+ * converted once into a key for which memcmp() yields this order. A digit
+ * run without leading zeros is stored as
+ *
+ *      length of the number ('1' - '8', or '9' followed by two bytes of
+ *      length for very long numbers)
+ *      digits
+ *
+ * and a run with leading zeros as
+ *
+ *      '0'
+ *      inverted number of leading zeros (one byte, or 0x00 followed by two
+ *      bytes for very long runs)
+ *      remaining digits, or 0xff if the run consists of zeros only
+ *
+ * The first byte of a run is always a digit, so runs compare against other
+ * characters just as in the name itself. Every name has a distinct key.
+ */
+
+#define SORT_BATCH_SIZE 16
+
+/* Lists shorter than this are sorted without any helper threads */
+#define SORT_PARALLEL_MIN (16 * 1024)
+
+struct sort_key {
+    const unsigned char *key;
+    uint32_t len;
+    uint32_t index;
+};
+
+struct sort_job {
+    struct sort_key *src;
+    struct sort_key *dst;
+    size_t size;
+    size_t width;
+    size_t n_split;
+};
+
+static unsigned char *version_key_run(unsigned char *p,
+                                      const unsigned char *s,
+                                      size_t len)
+{
+    size_t zeros = 0;
+
+    while (zeros < len && s[zeros] == '0')
+        ++zeros;
+
+    if (!zeros) {
+        if (len < 9) {
+            *p++ = (unsigned char) ('0' + len);
+        } else {
+            size_t n = (len < UINT16_MAX) ? len : UINT16_MAX;
+
+            *p++ = '9';
+            *p++ = (unsigned char) (n >> 8);
+            *p++ = (unsigned char) (n & 0xff);
+        }
+
+        memcpy(p, s, len);
+
+        return p + len;
+    }
+
+    *p++ = '0';
+
+    if (zeros < UINT8_MAX) {
+        *p++ = (unsigned char) (UINT8_MAX - zeros);
+    } else {
+        size_t n = UINT16_MAX - ((zeros < UINT16_MAX) ? zeros : UINT16_MAX);
+
+        *p++ = 0;
+        *p++ = (unsigned char) (n >> 8);
+        *p++ = (unsigned char) (n & 0xff);
+    }
+
+    if (zeros == len) {
+        *p++ = UINT8_MAX;
+        return p;
+    }
+
+    memcpy(p, s + zeros, len - zeros);
+
+    return p + len - zeros;
+}
+
+static size_t version_key(unsigned char *key, const char *str)
+{
+    const unsigned char *s = (const unsigned char *) str;
+    unsigned char *p = key;
+
+    while (*s != '\0') {
+        size_t len = 0;
+
+        if (!isdigit(*s)) {
+            *p++ = *s++;
+            continue;
+        }
+
+        while (isdigit(s[len]))
+            ++len;
+
+        p = version_key_run(p, s, len);
+        s += len;
+    }
+
+    return (size_t) (p - key);
+}
+
+static size_t version_key_size(const char *str)
+{
+    size_t size = 0;
+
+    for (; *str != '\0'; ++str) {
+        ++size;
+
+        /* Worst case: a single zero turns into three bytes */
+        if (isdigit((unsigned char) *str))
+            size += 2;
+    }
+
+    return size;
+}
+
+static int sort_key_cmp(const struct sort_key *a, const struct sort_key *b)
+{
+    uint32_t len = (a->len < b->len) ? a->len : b->len;
+    int diff = memcmp(a->key, b->key, len);
+
+    if (diff)
+        return diff;
+
+    return (a->len > b->len) - (a->len < b->len);
+}
+
+int load_compare(const char *a, const char *b)
+{
+    unsigned char mem[512], *buf = mem;
+    struct sort_key k1, k2;
+    size_t size;
+    int diff;
+
+    size = version_key_size(a) + version_key_size(b);
+    if (size > sizeof(mem)) {
+        buf = malloc(size);
+        if (!buf)
+            die("Out of memory\n");
+    }
+
+    k1.key = buf;
+    k1.len = (uint32_t) version_key(buf, a);
+    k2.key = buf + k1.len;
+    k2.len = (uint32_t) version_key(buf + k1.len, b);
+
+    diff = sort_key_cmp(&k1, &k2);
+
+    if (buf != mem)
+        free(buf);
+
+    return diff;
+}
+
+static void sort_batch(void *arg, size_t i)
+{
+    struct sort_job *job = arg;
+    struct sort_key *list = job->src;
+    size_t begin = i * SORT_BATCH_SIZE;
+    size_t end = begin + SORT_BATCH_SIZE;
+
+    if (end > job->size)
+        end = job->size;
+
+    for (size_t j = begin + 1; j < end; ++j) {
+        struct sort_key key = list[j];
+        size_t k = j;
+
+        while (k > begin && sort_key_cmp(&list[k - 1], &key) > 0) {
+            list[k] = list[k - 1];
+            --k;
+        }
+
+        list[k] = key;
+    }
+}
+
+/*
+ * Find how many elements of 'a' are among the first 'd' elements of the
+ * stable merge of 'a' and 'b'.
+ */
+static size_t merge_split(const struct sort_key *a,
+                          size_t n1,
+                          const struct sort_key *b,
+                          size_t n2,
+                          size_t d)
+{
+    size_t low = (d > n2) ? d - n2 : 0;
+    size_t high = (d < n1) ? d : n1;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if (sort_key_cmp(&a[mid], &b[d - mid - 1]) <= 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/*
+ * Every merge of two sorted runs is split into 'n_split' parts of equal
+ * output size, so the last passes with only a few, long runs still keep
+ * all threads busy.
+ */
+static void sort_merge(void *arg, size_t i)
+{
+    struct sort_job *job = arg;
+    size_t pair = i / job->n_split;
+    size_t part = i % job->n_split;
+    size_t begin = pair * 2 * job->width;
+    size_t mid = begin + job->width;
+    size_t end = mid + job->width;
+    const struct sort_key *a, *b;
+    struct sort_key *dst;
+    size_t n1, n2, d1, d2, i1, i2, e1, e2;
+
+    if (mid > job->size)
+        mid = job->size;
+
+    if (end > job->size)
+        end = job->size;
+
+    a = job->src + begin;
+    b = job->src + mid;
+    n1 = mid - begin;
+    n2 = end - mid;
+
+    d1 = (end - begin) * part / job->n_split;
+    d2 = (end - begin) * (part + 1) / job->n_split;
+
+    i1 = merge_split(a, n1, b, n2, d1);
+    e1 = merge_split(a, n1, b, n2, d2);
+    i2 = d1 - i1;
+    e2 = d2 - e1;
+
+    dst = job->dst + begin + d1;
+
+    while (i1 < e1 && i2 < e2) {
+        if (sort_key_cmp(&a[i1], &b[i2]) <= 0)
+            *dst++ = a[i1++];
+        else
+            *dst++ = b[i2++];
+    }
+
+    while (i1 < e1)
+        *dst++ = a[i1++];
+
+    while (i2 < e2)
+        *dst++ = b[i2++];
+}
+
+static size_t sort_threads(size_t size)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (size < SORT_PARALLEL_MIN || n <= 1)
+        return 0;
+
+    return (size_t) n - 1;
+}
+
+/*
+ * Find the order of 'names': 'order' receives the indices of the names in
+ * sorted order. Equal names keep their relative order.
+ */
+static void sort_order(const char *const *names, size_t size, uint32_t *order)
+{
+    struct sort_key *keys, *buf;
+    unsigned char *mem, *p;
+    struct sort_job job;
+    struct pool pool;
+    size_t len = 0;
+
+    if (size < 2) {
+        for (size_t i = 0; i < size; ++i)
+            order[i] = (uint32_t) i;
+
+        return;
+    }
+
+    for (size_t i = 0; i < size; ++i)
+        len += version_key_size(names[i]);
+
+    keys = malloc(size * sizeof(*keys));
+    buf = malloc(size * sizeof(*buf));
+    mem = malloc(len ? len : 1);
+    if (!keys || !buf || !mem)
+        die("Out of memory\n");
+
+    p = mem;
+
+    for (size_t i = 0; i < size; ++i) {
+        keys[i].key = p;
+        keys[i].len = (uint32_t) version_key(p, names[i]);
+        keys[i].index = (uint32_t) i;
+
+        p += keys[i].len;
+    }
+
+    pool_init(&pool, sort_threads(size));
+
+    job.src = keys;
+    job.dst = buf;
+    job.size = size;
+    job.width = SORT_BATCH_SIZE;
+
+    /* Sort small batches with insertion sort */
+    pool_run(&pool, (size + SORT_BATCH_SIZE - 1) / SORT_BATCH_SIZE,
+             &sort_batch, &job);
+
+    /* Merge the sorted batches until everything is sorted */
+    while (job.width < size) {
+        struct sort_key *tmp = job.src;
+        size_t n_pairs = (size + 2 * job.width - 1) / (2 * job.width);
+
+        job.n_split = (pool_size(&pool) + n_pairs - 1) / n_pairs;
+
+        pool_run(&pool, n_pairs * job.n_split, &sort_merge, &job);
+
+        job.src = job.dst;
+        job.dst = tmp;
+        job.width *= 2;
+    }
+
+    pool_destroy(&pool);
+
+    for (size_t i = 0; i < size; ++i)
+        order[i] = job.src[i].index;
+
+    free(mem);
+    free(buf);
+    free(keys);
+}
+
+/*
+ * Sort the items by their 'names'. The command lines in 'execs', if any,
+ * are moved along with them.
+ */
+static void sort(const char **names, const char **execs, size_t size)
+{
+    const char **tmp;
+    uint32_t *order;
+
+    if (size < 2)
+        return;
+
+    tmp = malloc(size * sizeof(*tmp));
+    order = malloc(size * sizeof(*order));
+    if (!tmp || !order)
+        die("Out of memory\n");
+
+    sort_order(names, size, order);
+
+    for (size_t i = 0; i < size; ++i)
+        tmp[i] = names[order[i]];
+
+    memcpy(names, tmp, size * sizeof(*names));
+
+    if (execs) {
+        for (size_t i = 0; i < size; ++i)
+            tmp[i] = execs[order[i]];
+
+        memcpy(execs, tmp, size * sizeof(*execs));
+    }
+
+    free(order);
+    free(tmp);
+}
+
+static size_t dedup(const char **names, const char **execs, size_t size)
+{
+    size_t i = 0;
+
+    if (!size)
+        return 0;
+
+    for (size_t j = 1; j < size; ++j) {
+        if (strcmp(names[i], names[j]) == 0)
+            continue;
+
+        names[++i] = names[j];
+        execs[i] = execs[j];
+    }
+
+    return i + 1;
+}
+
+/*
+ * Sort and deduplicate the items of 's' without moving their names. Of
+ * several items with the same name, the one added first is kept.
+ */
+static void sort_store(struct store *s)
+{
+    const char **names;
+    uint32_t *order;
+    size_t n = 0;
+
+    if (s->n < 2)
+        return;
+
+    names = malloc(s->n * sizeof(*names));
+    order = malloc(s->n * sizeof(*order));
+    if (!names || !order)
+        die("Out of memory\n");
+
+    for (size_t i = 0; i < s->n; ++i)
+        names[i] = store_name(s, i);
+
+    sort_order(names, s->n, order);
+
+    for (size_t i = 0; i < s->n; ++i) {
+        if (n && strcmp(names[order[n - 1]], names[order[i]]) == 0)
+            continue;
+
+        order[n++] = order[i];
+    }
+
+    store_reorder(s, order, n);
+
+    free(order);
+    free(names);
+}
+
+/* Directories searched if ${PATH} is not set */
+#define LOAD_DEFAULT_PATH "/bin:/usr/bin"
+
+/* Upper limit of threads used to scan the directories in ${PATH} */
+#define LOAD_MAX_THREADS 8
+
+/* Minimum space for reading a batch of directory entries */
+#define SCAN_BUFFER_SIZE (32 * 1024)
+
+/*
+ * Maximum number of statx() calls in flight and the number of entries of
+ * a directory for which setting up an io_uring pays off.
+ */
+#define SCAN_URING_ENTRIES 4096
+#define SCAN_URING_MIN_ENTRIES 32
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+struct scan_dir {
+    const char *path;
+    struct timespec mtime;
+
+    /* The names were taken from a still valid segment of the cache */
+    bool cached;
+
+    /*
+     * The names point into the entries read from the directory or into
+     * the cache. Both are only kept until the names were added to the
+     * complete list, where they start at 'offset' of its names.
+     */
+    const char **names;
+    size_t n;
+    size_t n_max;
+    size_t offset;
+
+    /* The raw entries as returned by getdents64() */
+    char *buf;
+    size_t size;
+};
+
+static void scan_add(struct scan_dir *dir, const char *name)
+{
+    if (dir->n >= dir->n_max) {
+        dir->n_max = dir->n_max * 2 - dir->n_max / 2;
+
+        dir->names = realloc(dir->names, dir->n_max * sizeof(*dir->names));
+        if (!dir->names)
+            die("Out of memory\n");
+    }
+
+    dir->names[dir->n++] = name;
+}
+
+static bool is_executable(mode_t mode)
+{
+    return S_ISREG(mode) && (mode & S_IXUSR);
+}
+
+bool load_is_item(int fd, const char *name)
+{
+    struct stat st;
+    int err;
+
+    if (name[0] == '.')
+        return false;
+
+    err = fstatat(fd, name, &st, 0);
+
+    return err == 0 && is_executable(st.st_mode);
+}
+
+static void scan_reject(struct scan_dir *dir, size_t i)
+{
+    dir->names[i] = NULL;
+}
+
+static void scan_stat_items(struct scan_dir *dir, int fd, size_t first)
+{
+    for (size_t i = first; i < dir->n; ++i) {
+        struct stat st;
+        int err;
+
+        err = fstatat(fd, dir->names[i], &st, 0);
+        if (err < 0 || !is_executable(st.st_mode))
+            scan_reject(dir, i);
+    }
+}
+
+#ifdef HAVE_IO_URING
+/*
+ * Submit the statx() calls for the entries of a directory in batches to an
+ * io_uring instance, which keeps up to SCAN_URING_ENTRIES lookups in
+ * flight at once. Every batch is submitted and reaped with a single system
+ * call, so a directory takes one call per SCAN_URING_ENTRIES entries
+ * instead of one per entry. Returns the number of checked entries. If
+ * io_uring is not available, nothing is checked and the caller falls back
+ * to the synchronous path.
+ */
+static size_t scan_statx_items(struct scan_dir *dir, int fd)
+{
+    unsigned int entries = SCAN_URING_ENTRIES;
+    size_t n_submit = 0, n_done = 0;
+    struct io_uring ring;
+    struct statx *stx;
+    int err;
+
+    if (dir->n < entries)
+        entries = (unsigned int) dir->n;
+
+    err = io_uring_queue_init(entries, &ring, 0);
+    if (err < 0)
+        return 0;
+
+    stx = malloc(dir->n * sizeof(*stx));
+    if (!stx)
+        die("Out of memory\n");
+
+    while (n_done < dir->n) {
+        struct io_uring_cqe *cqe;
+        unsigned int head, n = 0;
+
+        while (n_submit < dir->n) {
+            struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+            const char *name;
+
+            if (!sqe)
+                break;
+
+            name = dir->names[n_submit];
+
+            io_uring_prep_statx(sqe, fd, name, 0, STATX_MODE, &stx[n_submit]);
+            io_uring_sqe_set_data(sqe, (void *) (uintptr_t) n_submit);
+
+            ++n_submit;
+        }
+
+        /* Wait for the whole batch, which leaves the ring empty again */
+        err = io_uring_submit_and_wait(&ring, (unsigned) (n_submit - n_done));
+        if (err < 0) {
+            if (err == -EINTR)
+                continue;
+
+            die_error(-err, "io_uring_submit_and_wait()");
+        }
+
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            size_t i = (uintptr_t) io_uring_cqe_get_data(cqe);
+
+            if (cqe->res < 0 || !is_executable(stx[i].stx_mode))
+                scan_reject(dir, i);
+
+            ++n;
+        }
+
+        io_uring_cq_advance(&ring, n);
+        n_done += n;
+    }
+
+    io_uring_queue_exit(&ring);
+    free(stx);
+
+    return n_done;
+}
+#endif
+
+/*
+ * Only regular files with the executable bit are items, the same rule as
+ * in load_is_item(). The modes of all candidates are checked in one go
+ * after the whole directory was read, following symbolic links.
+ *
+ * Neither the type nor the inode number of an entry tells whether a file
+ * is executable, or was replaced by a non-executable one, so every
+ * candidate is looked up. With io_uring, the lookups are submitted in
+ * batches and take one system call per batch. Otherwise, every candidate
+ * takes one fstatat(). Directories which were not modified are spared the
+ * checks altogether, their cache segments are reused.
+ */
+static void scan_check_items(struct scan_dir *dir, int fd)
+{
+    size_t n = 0;
+
+    if (!dir->n)
+        return;
+
+#ifdef HAVE_IO_URING
+    if (dir->n >= SCAN_URING_MIN_ENTRIES)
+        n = scan_statx_items(dir, fd);
+#endif
+
+    scan_stat_items(dir, fd, n);
+
+    n = 0;
+
+    for (size_t i = 0; i < dir->n; ++i) {
+        if (dir->names[i])
+            dir->names[n++] = dir->names[i];
+    }
+
+    dir->n = n;
+}
+
+/*
+ * Read all entries of the directory before looking at them, so the names
+ * can be used in place: The buffer may still move while it grows.
+ */
+static void scan_read_dir(struct scan_dir *dir, int fd)
+{
+    size_t size_max = 0;
+
+    while (1) {
+        long size;
+
+        if (size_max - dir->size < SCAN_BUFFER_SIZE) {
+            size_max = (size_max) ? 2 * size_max : SCAN_BUFFER_SIZE;
+
+            dir->buf = realloc(dir->buf, size_max);
+            if (!dir->buf)
+                die("Out of memory\n");
+        }
+
+        size = syscall(SYS_getdents64,
+                       fd,
+                       dir->buf + dir->size,
+                       size_max - dir->size);
+        if (size < 0 && errno == EINTR)
+            continue;
+
+        if (size <= 0)
+            break;
+
+        dir->size += (size_t) size;
+    }
+}
+
+static void scan_dir(struct scan_dir *dir)
+{
+    int fd;
+
+    dir->n = 0;
+    dir->n_max = 1024;
+    dir->size = 0;
+
+    dir->names = malloc(dir->n_max * sizeof(*dir->names));
+    if (!dir->names)
+        die("Out of memory\n");
+
+    fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    scan_read_dir(dir, fd);
+
+    for (size_t i = 0; i < dir->size;) {
+        struct linux_dirent64 *entry = (void *) (dir->buf + i);
+
+        i += entry->d_reclen;
+
+        /* Hidden files are no commands a user wants to run */
+        if (entry->d_name[0] == '.')
+            continue;
+
+        /* Directories, sockets etc. are ruled out without a stat() */
+        switch (entry->d_type) {
+        case DT_REG:
+        case DT_LNK:
+        case DT_UNKNOWN:
+            scan_add(dir, entry->d_name);
+            break;
+        default:
+            break;
+        }
+    }
+
+    scan_check_items(dir, fd);
+
+    close(fd);
+}
+
+/* Fold the sorted names once, so the user interface never has to */
+static struct store *
+load_store(const char **names, const char **execs, size_t n)
+{
+    struct store *store = malloc(sizeof(*store));
+
+    if (!store)
+        die("Out of memory\n");
+
+    store_init(store);
+
+    for (size_t i = 0; i < n; ++i) {
+        store_add(store, names[i]);
+
+        if (execs)
+            store_set_exec(store, i, execs[i]);
+    }
+
+    return store;
+}
+
+static void load_push(struct loader *l,
+                      struct store *store,
+                      bool last,
+                      const struct trigram_index *index,
+                      const struct prefix_index *prefix)
+{
+    struct load_chunk *chunk = malloc(sizeof(*chunk));
+    uint64_t val = 1;
+    ssize_t size;
+
+    if (!chunk)
+        die("Out of memory\n");
+
+    chunk->store = store;
+    chunk->last = last;
+    chunk->index = index;
+    chunk->prefix = prefix;
+
+    queue_push(&l->queue, chunk);
+
+    do {
+        size = write(l->event_fd, &val, sizeof(val));
+    } while (size < 0 && errno == EINTR);
+}
+
+/* Hand sorted items over to the user interface */
+static void load_publish(struct loader *l, struct store *store)
+{
+    load_push(l, store, false, NULL, NULL);
+}
+
+/* Hand over the complete list, the indices cover all of its items */
+static void load_finish(struct loader *l,
+                        struct store *store,
+                        const struct trigram_index *index,
+                        const struct prefix_index *prefix)
+{
+    load_push(l, store, true, index, prefix);
+}
+
+static void load_publish_dir(struct loader *l, struct scan_dir *dir)
+{
+    if (!dir->n)
+        return;
+
+    sort(dir->names, NULL, dir->n);
+
+    load_publish(l, load_store(dir->names, NULL, dir->n));
+}
+
+/*
+ * Append the names of 'dir' to the complete list, which is only sorted
+ * once all directories are done. This is the only copy of the names the
+ * loader keeps, the entries read from the directory are dropped.
+ */
+static void load_add_dir(struct store *store,
+                         pthread_mutex_t *mutex,
+                         struct scan_dir *dir)
+{
+    pthread_mutex_lock(mutex);
+
+    dir->offset = store->size;
+
+    for (size_t i = 0; i < dir->n; ++i)
+        store_add(store, dir->names[i]);
+
+    pthread_mutex_unlock(mutex);
+
+    free(dir->names);
+    free(dir->buf);
+
+    dir->names = NULL;
+    dir->buf = NULL;
+}
+
+/*
+ * Publish the applications of all shown desktop entries at once. There
+ * are only a few hundred of them at most.
+ */
+static void
+load_publish_desktop(struct loader *l, struct desktop_file *files, size_t n)
+{
+    const char **names, **execs;
+    size_t size = 0;
+
+    names = malloc((n ? n : 1) * sizeof(*names));
+    execs = malloc((n ? n : 1) * sizeof(*execs));
+    if (!names || !execs)
+        die("Out of memory\n");
+
+    for (size_t i = 0; i < n; ++i) {
+        if (!files[i].shown)
+            continue;
+
+        names[size] = files[i].label;
+        execs[size] = files[i].exec;
+        ++size;
+    }
+
+    if (size) {
+        sort(names, execs, size);
+        size = dedup(names, execs, size);
+
+        load_publish(l, load_store(names, execs, size));
+    }
+
+    free(execs);
+    free(names);
+}
+
+/*
+ * The directories of ${PATH} and the desktop entries are processed by the
+ * same pool: The first 'n_dirs' tasks scan a directory, the remaining ones
+ * parse one desktop entry each.
+ */
+struct scan_job {
+    struct loader *loader;
+    struct scan_dir *dirs;
+    size_t n_dirs;
+    struct desktop_file *files;
+    const char *path;
+
+    /* The complete list, which all directories are added to */
+    struct store *store;
+    pthread_mutex_t mutex;
+};
+
+static void scan_task(void *arg, size_t i)
+{
+    struct scan_job *job = arg;
+    struct scan_dir *dir;
+
+    if (i >= job->n_dirs) {
+        struct desktop_file *file = &job->files[i - job->n_dirs];
+
+        if (!file->cached)
+            desktop_parse(file);
+
+        file->shown = desktop_is_item(file, job->path);
+        return;
+    }
+
+    dir = &job->dirs[i];
+
+    if (dir->cached)
+        return;
+
+    scan_dir(dir);
+    load_publish_dir(job->loader, dir);
+    load_add_dir(job->store, &job->mutex, dir);
+}
+
+static size_t scan_threads(size_t n_dirs)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
 
-#include "load.h"
+    /*
+     * Scanning is mostly bound by the latency of the file systems,
+     * so use at least a few threads even on small machines.
+     */
+    if (n < 4)
+        n = 4;
+
+    if (n > LOAD_MAX_THREADS)
+        n = LOAD_MAX_THREADS;
+
+    if ((size_t) n > n_dirs)
+        n = (long) n_dirs;
+
+    /* The calling thread takes part in the scan */
+    return (n > 0) ? (size_t) n - 1 : 0;
+}
+
+/*
+ * Layout of the binary cache file:
+ *
+ *      struct cache_header
+ *      struct cache_dir dirs[n_dirs]
+ *      struct cache_file files[n_files]
+ *      uint32_t names[n_names]
+ *      uint32_t offsets[n_items]
+ *      uint32_t lens[n_items]
+ *      uint32_t execs[n_execs]
+ *      struct trigram trigrams[n_trigrams]
+ *      uint32_t postings[n_postings]
+ *      uint32_t prefix[n_prefix]
+ *      char blob[blob_size]
+ *      char store_names[store_size]
+ *      char store_folds[store_size]
+ *
+ * Every directory of ${PATH} owns one segment of the cache, which stores
+ * the directory's modification time and the range of its entries in
+ * 'names'. These are offsets into 'store_names', which keeps the names of
+ * all entries, even of the ones left out of the list as duplicates. The
+ * segments of unchanged directories are reused when ${PATH} has to be
+ * rescanned partially. Likewise, 'files' stores the parsed values
+ * and the modification time of every desktop entry, sorted by path, so only
+ * modified entries are parsed again. The offsets of these entries refer to
+ * null-terminated strings inside 'blob', CACHE_NONE marks a string which
+ * is not present.
+ *
+ * The sorted and deduplicated list of all items is stored in the layout of
+ * struct store: 'offsets', 'lens' and 'execs' are its arrays, which refer
+ * to 'store_names' and 'store_folds'. 'execs' is left out if no item has a
+ * command line. The list is used as is if neither a directory nor a
+ * desktop entry changed. 'trigrams' and 'postings' form the trigram index
+ * of the list and 'prefix' holds the indices of its items ordered by their
+ * case-folded names. Both are only present for long lists. The file is
+ * mapped read-only and used in place, so reading the cache does not copy,
+ * fold or parse any names.
+ */
 
-static void merge(struct item *dst,
-                  struct item *src,
-                  size_t i,
-                  size_t e1,
-                  size_t j,
-                  size_t e2)
+#define CACHE_MAGIC 0x554e454d /* "MENU" */
+#define CACHE_VERSION 11
+#define CACHE_NONE UINT32_MAX
+
+struct cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_dirs;
+    uint32_t n_files;
+    uint32_t n_names;
+    uint32_t n_items;
+    uint32_t n_execs;
+    uint32_t n_trigrams;
+    uint32_t n_postings;
+    uint32_t n_prefix;
+    uint32_t blob_size;
+    uint32_t store_size;
+};
+
+struct cache_dir {
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint32_t path;
+    uint32_t first;
+    uint32_t n;
+    uint32_t reserved;
+};
+
+struct cache_file {
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint32_t path;
+    uint32_t name;
+    uint32_t exec;
+    uint32_t try_exec;
+};
+
+struct cache {
+    void *mem;
+    size_t size;
+
+    const struct cache_header *header;
+    const struct cache_dir *dirs;
+    const struct cache_file *files;
+    const uint32_t *names;
+    const uint32_t *offsets;
+    const uint32_t *lens;
+    const uint32_t *execs;
+    const struct trigram *trigrams;
+    const uint32_t *postings;
+    const uint32_t *prefix;
+    const char *blob;
+    const char *store_names;
+    const char *store_folds;
+};
+
+static bool cache_check_offset(const struct cache *c, uint32_t offset)
 {
-    while (i < e1 && j < e2) {
-        if (strverscmp(src[i].name, src[j].name) <= 0)
-            dst++->name = src[i++].name;
-        else
-            dst++->name = src[j++].name;
-    }
+    return offset == CACHE_NONE || offset < c->header->blob_size;
+}
 
-    while (i < e1)
-        dst++->name = src[i++].name;
+static bool cache_check_names(const struct cache *c)
+{
+    for (uint32_t i = 0; i < c->header->n_names; ++i) {
+        if (c->names[i] >= c->header->store_size)
+            return false;
+    }
 
-    while (j < e2)
-        dst++->name = src[j++].name;
+    return true;
 }
 
-static void sort(struct item *list, size_t size)
+static bool cache_check_files(const struct cache *c)
 {
-    struct item *buf = malloc(size * sizeof(*buf));
-    struct item item = {NULL, 0};
-    size_t n = 16;
+    for (uint32_t i = 0; i < c->header->n_files; ++i) {
+        const struct cache_file *file = &c->files[i];
 
-    if (!buf)
-        die("Out of memory\n");
+        if (file->path >= c->header->blob_size)
+            return false;
 
-    /* Sort small batches of size 'n' with insertion sort */
+        if (!cache_check_offset(c, file->name))
+            return false;
 
-    for (size_t i = 0; i < size; i += n) {
-        size_t end = i + n;
+        if (!cache_check_offset(c, file->exec))
+            return false;
 
-        if (end >= size)
-            end = size;
+        if (!cache_check_offset(c, file->try_exec))
+            return false;
+    }
 
-        for (size_t j = i + 1; j < end; ++j) {
-            size_t k = j;
+    return true;
+}
 
-            item.name = list[j].name;
+/* Every item has to be a null-terminated string in both blobs */
+static bool cache_check_items(const struct cache *c)
+{
+    const struct cache_header *header = c->header;
 
-            while (k > i && strverscmp(list[k - 1].name, item.name) > 0) {
-                list[k].name = list[k - 1].name;
-                --k;
-            }
+    if (header->n_execs && header->n_execs != header->n_items)
+        return false;
 
-            list[k].name = item.name;
-        }
-    }
+    for (uint32_t i = 0; i < header->n_items; ++i) {
+        size_t end = (size_t) c->offsets[i] + c->lens[i];
 
-    /* Merge the small sorted batches until everything is sorted */
+        if (end >= header->store_size)
+            return false;
 
-    while (n < size) {
-        struct item *dst = buf;
-        struct item *src = list;
+        if (c->store_names[end] != '\0' || c->store_folds[end] != '\0')
+            return false;
+    }
 
-        for (size_t i = 0; i < size; i += (n + n)) {
-            size_t j = i + n;
-            size_t k = j + n;
+    for (uint32_t i = 0; i < header->n_execs; ++i) {
+        if (c->execs[i] != CACHE_NONE && c->execs[i] >= header->store_size)
+            return false;
+    }
 
-            if (j >= size)
-                j = size;
+    return true;
+}
 
-            if (k >= size)
-                k = size;
+static bool cache_check_trigrams(const struct cache *c)
+{
+    const struct cache_header *header = c->header;
 
-            merge(dst, src, i, j, j, k);
-            dst += k - i;
-        }
+    for (uint32_t i = 0; i < header->n_trigrams; ++i) {
+        const struct trigram *t = &c->trigrams[i];
 
-        n *= 2;
+        if (t->first > header->n_postings || t->n > header->n_postings)
+            return false;
 
-        dst = list;
-        src = buf;
+        if ((size_t) t->first + t->n > header->n_postings)
+            return false;
+    }
 
-        for (size_t i = 0; i < size; i += (n + n)) {
-            size_t j = i + n;
-            size_t k = j + n;
+    for (uint32_t i = 0; i < header->n_postings; ++i) {
+        if (c->postings[i] >= header->n_items)
+            return false;
+    }
 
-            if (j >= size)
-                j = size;
+    return true;
+}
 
-            if (k >= size)
-                k = size;
+static bool cache_check_prefix(const struct cache *c)
+{
+    const struct cache_header *header = c->header;
 
-            merge(dst, src, i, j, j, k);
-            dst += k - i;
-        }
+    if (header->n_prefix && header->n_prefix != header->n_items)
+        return false;
 
-        n *= 2;
+    for (uint32_t i = 0; i < header->n_prefix; ++i) {
+        if (c->prefix[i] >= header->n_items)
+            return false;
     }
 
-    free(buf);
+    return true;
 }
 
-static size_t dedup(struct item *list, size_t size)
+static bool cache_check(struct cache *c)
 {
-    size_t i = 0;
+    const struct cache_header *header = c->mem;
+    size_t n;
 
-    for (size_t j = 1; j < size; ++j) {
-        if (strcmp(list[i].name, list[j].name) != 0)
-            list[++i].name = list[j].name;
+    if (c->size < sizeof(*header))
+        return false;
+
+    if (header->magic != CACHE_MAGIC || header->version != CACHE_VERSION)
+        return false;
+
+    n = sizeof(*header);
+    n += header->n_dirs * sizeof(*c->dirs);
+    n += header->n_files * sizeof(*c->files);
+    n += header->n_names * sizeof(*c->names);
+    n += 2 * (size_t) header->n_items * sizeof(*c->offsets);
+    n += header->n_execs * sizeof(*c->execs);
+    n += header->n_trigrams * sizeof(*c->trigrams);
+    n += header->n_postings * sizeof(*c->postings);
+    n += header->n_prefix * sizeof(*c->prefix);
+    n += header->blob_size;
+    n += 2 * (size_t) header->store_size;
+
+    if (n != c->size)
+        return false;
+
+    c->header = header;
+    c->dirs = (const struct cache_dir *) (header + 1);
+    c->files = (const struct cache_file *) (c->dirs + header->n_dirs);
+    c->names = (const uint32_t *) (c->files + header->n_files);
+    c->offsets = c->names + header->n_names;
+    c->lens = c->offsets + header->n_items;
+    c->execs = c->lens + header->n_items;
+    c->trigrams = (const struct trigram *) (c->execs + header->n_execs);
+    c->postings = (const uint32_t *) (c->trigrams + header->n_trigrams);
+    c->prefix = c->postings + header->n_postings;
+    c->blob = (const char *) (c->prefix + header->n_prefix);
+    c->store_names = c->blob + header->blob_size;
+    c->store_folds = c->store_names + header->store_size;
+
+    if (!header->blob_size || c->blob[header->blob_size - 1] != '\0')
+        return false;
+
+    if (header->store_size
+        && c->store_names[header->store_size - 1] != '\0')
+        return false;
+
+    for (uint32_t i = 0; i < header->n_dirs; ++i) {
+        const struct cache_dir *dir = &c->dirs[i];
+
+        if (dir->path >= header->blob_size)
+            return false;
+
+        if (dir->first > header->n_names || dir->n > header->n_names)
+            return false;
+
+        if ((size_t) dir->first + dir->n > header->n_names)
+            return false;
     }
 
-    return i;
+    if (!cache_check_files(c))
+        return false;
+
+    if (!cache_check_names(c))
+        return false;
+
+    if (!cache_check_items(c))
+        return false;
+
+    if (!cache_check_trigrams(c))
+        return false;
+
+    return cache_check_prefix(c);
 }
 
-static ssize_t do_cache_read(int fd, const char *path, struct item **list)
+static int cache_open(struct cache *c, const char *path)
 {
-    char *iter = strdupa(path);
-    size_t size = 0, n = 0, n_max;
     struct stat st;
-    char *mem;
-    int err;
+    int fd, err;
 
-    err = fstat(fd, &st);
-    if (err < 0)
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
         return -errno;
 
-    if (st.st_size < 0)
-        return -EINVAL;
+    err = fstat(fd, &st);
+    if (err < 0) {
+        err = -errno;
+        goto out;
+    }
+
+    c->size = (size_t) st.st_size;
 
-    /*
-     * Check if the last modification to the cache was made after
-     * changes to the directories specified in 'path'.
-     */
+    c->mem = mmap(NULL, c->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (c->mem == MAP_FAILED) {
+        err = -errno;
+        goto out;
+    }
 
-    while (iter) {
-        struct stat buf;
-        char *str = strsep(&iter, ":");
+    if (!cache_check(c)) {
+        munmap(c->mem, c->size);
+        err = -EINVAL;
+    }
 
-        err = stat(str, &buf);
-        if (err < 0)
-            return -errno;
+out:
+    close(fd);
 
-        if (buf.st_mtim.tv_sec < st.st_mtim.tv_sec)
-            continue;
+    return err;
+}
+
+static void cache_close(struct cache *c)
+{
+    munmap(c->mem, c->size);
+}
+
+static char *cache_string(const struct cache *c, uint32_t offset)
+{
+    return (offset != CACHE_NONE) ? (char *) c->blob + offset : NULL;
+}
+
+static bool cache_dir_valid(const struct cache_dir *cd,
+                            const char *path,
+                            const struct scan_dir *dir)
+{
+    if (cd->mtime_sec != dir->mtime.tv_sec)
+        return false;
+
+    if (cd->mtime_nsec != dir->mtime.tv_nsec)
+        return false;
+
+    return strcmp(path, dir->path) == 0;
+}
 
-        if (buf.st_mtim.tv_sec > st.st_mtim.tv_sec)
-            return -EINVAL;
+static bool cache_is_exact(const struct cache *c,
+                           const struct scan_dir *dirs,
+                           size_t n_dirs,
+                           size_t n_files)
+{
+    if (c->header->n_dirs != n_dirs || c->header->n_files != n_files)
+        return false;
+
+    for (size_t i = 0; i < n_dirs; ++i) {
+        const char *path = c->blob + c->dirs[i].path;
 
-        if (buf.st_mtim.tv_nsec > st.st_mtim.tv_nsec)
-            return -EINVAL;
+        if (!cache_dir_valid(&c->dirs[i], path, &dirs[i]))
+            return false;
     }
 
-    /* Read the whole file in one go */
-    mem = malloc(st.st_size * sizeof(*mem));
-    if (!mem)
-        return -errno;
+    return true;
+}
 
-    do {
-        ssize_t m = read(fd, mem + size, st.st_size - size);
-        if (m < 0) {
-            if (errno == EINTR)
-                continue;
+/* Take the entries of every directory whose cache segment is up to date */
+static size_t
+cache_load_segments(const struct cache *c, struct scan_dir *dirs, size_t n)
+{
+    size_t n_valid = 0;
 
-            return -errno;
+    for (size_t i = 0; i < n; ++i) {
+        struct scan_dir *dir = &dirs[i];
+        const struct cache_dir *cd = NULL;
+
+        for (uint32_t j = 0; j < c->header->n_dirs && !cd; ++j) {
+            const char *path = c->blob + c->dirs[j].path;
+
+            if (cache_dir_valid(&c->dirs[j], path, dir))
+                cd = &c->dirs[j];
         }
 
-        size += m;
-    } while (size < (size_t) st.st_size);
+        if (!cd)
+            continue;
+
+        dir->cached = true;
+        dir->n = cd->n;
+        dir->names = malloc((dir->n ? dir->n : 1) * sizeof(*dir->names));
+        if (!dir->names)
+            die("Out of memory\n");
 
-    /* Does 'path' match with the information stored in the cache */
-    if (strcmp(path, strsep(&mem, "\n")) != 0)
-        return -EINVAL;
+        for (size_t j = 0; j < dir->n; ++j)
+            dir->names[j] = c->store_names + c->names[cd->first + j];
 
-    /* Retrieve the number of items stored in the cache */
-    if (!mem || !isdigit(mem[0]))
-        return -EINVAL;
+        ++n_valid;
+    }
 
-    n_max = strtoul(mem, &mem, 10);
+    return n_valid;
+}
 
-    *list = malloc(n_max * sizeof(**list));
-    if (!*list)
-        return -errno;
+static const struct cache_file *cache_find_file(const struct cache *c,
+                                                const char *path)
+{
+    size_t low = 0, high = c->header->n_files;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        int diff = strcmp(c->blob + c->files[mid].path, path);
+
+        if (diff == 0)
+            return &c->files[mid];
+
+        if (diff < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return NULL;
+}
+
+/* Take the parsed values of every desktop entry which was not modified */
+static size_t
+cache_load_files(const struct cache *c, struct desktop_file *files, size_t n)
+{
+    size_t n_valid = 0;
 
-    /* Retrieve all items from the cache */
-    while (mem) {
-        char *line = strsep(&mem, "\n");
-        size_t len = strlen(line);
+    for (size_t i = 0; i < n; ++i) {
+        struct desktop_file *file = &files[i];
+        const struct cache_file *cf = cache_find_file(c, file->path);
 
-        if (!len)
+        if (!cf || cf->mtime_sec != file->mtime.tv_sec)
             continue;
 
-        if (n >= n_max)
-            return -EINVAL;
+        if (cf->mtime_nsec != file->mtime.tv_nsec)
+            continue;
 
-        (*list)[n].hits = 0;
-        (*list)[n].name = line;
+        file->cached = true;
+        file->name = cache_string(c, cf->name);
+        file->exec = cache_string(c, cf->exec);
+        file->try_exec = cache_string(c, cf->try_exec);
 
-        ++n;
+        ++n_valid;
     }
 
-    return n;
+    return n_valid;
 }
 
-static ssize_t
-cache_read(const char *cache, const char *path, struct item **list)
+/* The items are used in place, the mapping has to outlive them */
+static struct store *cache_items(const struct cache *c)
 {
-    int fd = open(cache, O_RDONLY);
-    ssize_t size;
+    const struct cache_header *header = c->header;
+    struct store *store = malloc(sizeof(*store));
 
-    if (fd < 0)
-        return -errno;
+    if (!store)
+        die("Out of memory\n");
 
-    size = do_cache_read(fd, path, list);
+    /* clang-format off */
+    store_init_view(store, c->store_names, c->store_folds,
+                    header->store_size, c->offsets, c->lens,
+                    (header->n_execs) ? c->execs : NULL, header->n_items);
+    /* clang-format on */
 
-    close(fd);
+    return store;
+}
 
-    return size;
+static const struct trigram_index *
+cache_index(const struct cache *c, struct arena *arena)
+{
+    struct trigram_index *index;
+
+    if (!c->header->n_trigrams)
+        return NULL;
+
+    index = arena_alloc(arena, sizeof(*index));
+    index->trigrams = c->trigrams;
+    index->n_trigrams = c->header->n_trigrams;
+    index->postings = c->postings;
+    index->n_postings = c->header->n_postings;
+    index->n_items = c->header->n_items;
+
+    return index;
 }
 
-static void
-cache_write(const char *cache, const char *path, struct item *list, size_t size)
+static const struct prefix_index *
+cache_prefix(const struct cache *c, struct arena *arena)
+{
+    struct prefix_index *prefix;
+
+    if (!c->header->n_prefix)
+        return NULL;
+
+    prefix = arena_alloc(arena, sizeof(*prefix));
+    prefix->index = c->prefix;
+    prefix->n = c->header->n_prefix;
+
+    return prefix;
+}
+
+static uint32_t cache_offset(const char *blob, const char *str)
 {
-    FILE *file = fopen(cache, "w");
-    if (!file)
+    return (str) ? (uint32_t) (str - blob) : CACHE_NONE;
+}
+
+static void cache_write(const char *cache,
+                        const struct scan_dir *dirs,
+                        size_t n_dirs,
+                        const struct desktop_file *files,
+                        size_t n_files,
+                        const char *blob,
+                        size_t blob_size,
+                        const struct store *store,
+                        const struct trigram_index *index,
+                        const struct prefix_index *prefix)
+{
+    struct cache_header *header;
+    struct cache_dir *cd;
+    struct cache_file *cf;
+    struct trigram *trigrams;
+    uint32_t *postings, *prefix_index, *offsets, *lens, *execs;
+    size_t n_items = store->n, n_execs = (store->execs) ? store->n : 0;
+    size_t n_trigrams = 0, n_postings = 0, n_prefix = 0;
+    struct iovec iov[4];
+    uint32_t *names;
+    size_t n_names = 0, len;
+    char *mem;
+
+    for (size_t i = 0; i < n_dirs; ++i)
+        n_names += dirs[i].n;
+
+    /* CACHE_NONE must never be a valid offset */
+    if (blob_size >= UINT32_MAX || n_names > UINT32_MAX)
         return;
 
-    fprintf(file, "%s\n%lu\n\n", path, size);
+    if (store->size >= UINT32_MAX || n_items > UINT32_MAX)
+        return;
 
-    for (size_t i = 0; i < size; ++i)
-        fprintf(file, "%s\n", list[i].name);
+    if (index) {
+        n_trigrams = index->n_trigrams;
+        n_postings = index->n_postings;
+    }
+
+    if (prefix)
+        n_prefix = prefix->n;
+
+    /* Everything except for the blobs goes into one buffer */
+    len = sizeof(*header);
+    len += n_dirs * sizeof(*cd);
+    len += n_files * sizeof(*cf);
+    len += n_names * sizeof(*names);
+    len += 2 * n_items * sizeof(*offsets);
+    len += n_execs * sizeof(*execs);
+    len += n_trigrams * sizeof(*trigrams);
+    len += n_postings * sizeof(*postings);
+    len += n_prefix * sizeof(*prefix_index);
+
+    mem = malloc(len);
+    if (!mem)
+        return;
+
+    header = (struct cache_header *) mem;
+    cd = (struct cache_dir *) (header + 1);
+    cf = (struct cache_file *) (cd + n_dirs);
+    names = (uint32_t *) (cf + n_files);
+    offsets = names + n_names;
+    lens = offsets + n_items;
+    execs = lens + n_items;
+    trigrams = (struct trigram *) (execs + n_execs);
+    postings = (uint32_t *) (trigrams + n_trigrams);
+    prefix_index = postings + n_postings;
+
+    n_names = 0;
+
+    for (size_t i = 0; i < n_dirs; ++i) {
+        size_t offset = dirs[i].offset;
+
+        cd[i].mtime_sec = dirs[i].mtime.tv_sec;
+        cd[i].mtime_nsec = dirs[i].mtime.tv_nsec;
+        cd[i].path = (uint32_t) (dirs[i].path - blob);
+        cd[i].first = (uint32_t) n_names;
+        cd[i].n = (uint32_t) dirs[i].n;
+        cd[i].reserved = 0;
+
+        /* The names of a directory were added back to back */
+        for (size_t j = 0; j < dirs[i].n; ++j) {
+            names[n_names++] = (uint32_t) offset;
+            offset += strlen(store->names + offset) + 1;
+        }
+    }
+
+    for (size_t i = 0; i < n_files; ++i) {
+        cf[i].mtime_sec = files[i].mtime.tv_sec;
+        cf[i].mtime_nsec = files[i].mtime.tv_nsec;
+        cf[i].path = (uint32_t) (files[i].path - blob);
+        cf[i].name = cache_offset(blob, files[i].name);
+        cf[i].exec = cache_offset(blob, files[i].exec);
+        cf[i].try_exec = cache_offset(blob, files[i].try_exec);
+    }
+
+    memcpy(offsets, store->offsets, n_items * sizeof(*offsets));
+    memcpy(lens, store->lens, n_items * sizeof(*lens));
+
+    if (n_execs)
+        memcpy(execs, store->execs, n_execs * sizeof(*execs));
+
+    if (index) {
+        memcpy(trigrams, index->trigrams, n_trigrams * sizeof(*trigrams));
+        memcpy(postings, index->postings, n_postings * sizeof(*postings));
+    }
 
-    fclose(file);
+    if (prefix)
+        memcpy(prefix_index, prefix->index, n_prefix * sizeof(*prefix_index));
+
+    header->magic = CACHE_MAGIC;
+    header->version = CACHE_VERSION;
+    header->n_dirs = (uint32_t) n_dirs;
+    header->n_files = (uint32_t) n_files;
+    header->n_names = (uint32_t) n_names;
+    header->n_items = (uint32_t) n_items;
+    header->n_execs = (uint32_t) n_execs;
+    header->n_trigrams = (uint32_t) n_trigrams;
+    header->n_postings = (uint32_t) n_postings;
+    header->n_prefix = (uint32_t) n_prefix;
+    header->blob_size = (uint32_t) blob_size;
+    header->store_size = (uint32_t) store->size;
+
+    iov[0].iov_base = mem;
+    iov[0].iov_len = len;
+    iov[1].iov_base = (void *) blob;
+    iov[1].iov_len = blob_size;
+    iov[2].iov_base = store->names;
+    iov[2].iov_len = store->size;
+    iov[3].iov_base = store->folds;
+    iov[3].iov_len = store->size;
+
+    /* The cache is only an optimization, so failing to write it is fine */
+    (void) write_file_atomic(cache, iov, 4);
+
+    free(mem);
 }
 
-static size_t do_load(const char *path, const char *cache, struct item **list)
+static void dir_mtime(const char *path, struct timespec *mtime)
 {
-    size_t n = 0, n_max = 4096;
-    char *iter;
-    ssize_t size;
+    struct stat st;
+    int err;
+
+    err = stat(path, &st);
+    if (err < 0) {
+        /* Marks a directory which does not exist */
+        mtime->tv_sec = -1;
+        mtime->tv_nsec = -1;
+        return;
+    }
+
+    *mtime = st.st_mtim;
+}
+
+static size_t blob_len(const char *str)
+{
+    return (str) ? strlen(str) + 1 : 0;
+}
+
+static char *blob_copy(char **p, const char *str)
+{
+    char *dst = *p;
+
+    if (!str)
+        return NULL;
+
+    *p = stpcpy(dst, str) + 1;
+
+    return dst;
+}
+
+/*
+ * Copy the paths of all directories and the values of all desktop entries
+ * into one contiguous blob, which is the layout of the blob stored in the
+ * cache. The names of the directories are part of the complete list.
+ */
+static char *build_blob(struct scan_dir *dirs,
+                        size_t n_dirs,
+                        struct desktop_file *files,
+                        size_t n_files,
+                        size_t *size)
+{
+    size_t len = 0;
+    char *blob, *p;
+
+    for (size_t i = 0; i < n_dirs; ++i)
+        len += blob_len(dirs[i].path);
+
+    for (size_t i = 0; i < n_files; ++i) {
+        len += blob_len(files[i].path);
+        len += blob_len(files[i].name);
+        len += blob_len(files[i].exec);
+        len += blob_len(files[i].try_exec);
+
+        if (files[i].label != files[i].name)
+            len += blob_len(files[i].label);
+    }
+
+    blob = malloc(len ? len : 1);
+    if (!blob)
+        die("Out of memory\n");
 
-    size = cache_read(cache, path, list);
-    if (size >= 0)
-        return (size_t) size;
+    p = blob;
 
-    *list = malloc(n_max * sizeof(**list));
-    if (!list)
+    for (size_t i = 0; i < n_dirs; ++i)
+        dirs[i].path = blob_copy(&p, dirs[i].path);
+
+    for (size_t i = 0; i < n_files; ++i) {
+        struct desktop_file *file = &files[i];
+        bool named = (file->label == file->name);
+
+        file->path = blob_copy(&p, file->path);
+        file->name = blob_copy(&p, file->name);
+        file->exec = blob_copy(&p, file->exec);
+        file->try_exec = blob_copy(&p, file->try_exec);
+        file->label = (named) ? file->name : blob_copy(&p, file->label);
+    }
+
+    *size = len;
+
+    return blob;
+}
+
+/*
+ * Every directory is handed over to the user interface as soon as it was
+ * read, so the menu does not have to wait for the slowest directory. The
+ * complete list is only put together for the cache.
+ */
+static void do_load(const char *path,
+                    const char *data_dirs,
+                    const char *cache,
+                    struct loader *l)
+{
+    struct scan_dir *dirs;
+    struct desktop_file *files;
+    struct scan_job job;
+    struct cache c = { 0 };
+    struct pool pool;
+    struct store *store;
+    struct trigram_index *index = NULL;
+    struct prefix_index *prefix = NULL;
+    size_t n_dirs = 1, n_files, n_scan, blob_size;
+    size_t n_valid = 0, n_valid_files = 0;
+    bool cached;
+    char *iter, *blob;
+
+    for (const char *p = path; *p != '\0'; ++p) {
+        if (*p == ':')
+            ++n_dirs;
+    }
+
+    dirs = malloc(n_dirs * sizeof(*dirs));
+    if (!dirs)
         die("Out of memory\n");
 
     iter = strdupa(path);
-    while (iter) {
-        char *token = strsep(&iter, ":");
-        DIR *dir = opendir(token);
-        int fd;
+    for (size_t i = 0; i < n_dirs; ++i) {
+        dirs[i].path = strsep(&iter, ":");
+        dirs[i].cached = false;
+        dirs[i].names = NULL;
+        dirs[i].n = 0;
+        dirs[i].offset = 0;
+        dirs[i].buf = NULL;
+        dirs[i].size = 0;
+
+        dir_mtime(dirs[i].path, &dirs[i].mtime);
+    }
+
+    n_files = desktop_list_files(data_dirs, &files, &l->arena);
+
+    cached = (cache_open(&c, cache) == 0);
+
+    if (cached)
+        n_valid_files = cache_load_files(&c, files, n_files);
 
-        if (!dir)
+    if (cached && n_valid_files == n_files
+        && cache_is_exact(&c, dirs, n_dirs, n_files)) {
+        /* The items and indices are used in place for as long as they live */
+        arena_add_mmap(&l->arena, c.mem, c.size);
+
+        /* clang-format off */
+        load_finish(l, cache_items(&c), cache_index(&c, &l->arena),
+                    cache_prefix(&c, &l->arena));
+        /* clang-format on */
+
+        free(files);
+        free(dirs);
+        return;
+    }
+
+    store = malloc(sizeof(*store));
+    if (!store)
+        die("Out of memory\n");
+
+    store_init(store);
+
+    job.loader = l;
+    job.dirs = dirs;
+    job.n_dirs = n_dirs;
+    job.files = files;
+    job.path = path;
+    job.store = store;
+
+    pthread_mutex_init(&job.mutex, NULL);
+
+    if (cached)
+        n_valid = cache_load_segments(&c, dirs, n_dirs);
+
+    for (size_t i = 0; i < n_dirs; ++i) {
+        if (!dirs[i].cached)
             continue;
 
-        fd = dirfd(dir);
+        load_publish_dir(l, &dirs[i]);
+        load_add_dir(store, &job.mutex, &dirs[i]);
+    }
 
-        while (1) {
-            struct dirent *entry = readdir(dir);
-            struct stat st;
-            int err;
+    /* Only rescan the directories and entries which changed */
+    n_scan = n_dirs - n_valid + n_files - n_valid_files;
 
-            if (!entry)
-                break;
+    pool_init(&pool, scan_threads(n_scan));
+    pool_run(&pool, n_dirs + n_files, &scan_task, &job);
+    pool_destroy(&pool);
 
-            err = fstatat(fd, entry->d_name, &st, 0);
-            if (err < 0)
-                continue;
+    pthread_mutex_destroy(&job.mutex);
 
-            if (!S_ISREG(st.st_mode) || !(st.st_mode & S_IXUSR))
-                continue;
+    for (size_t i = 0; i < n_files; ++i) {
+        if (!files[i].cached)
+            desktop_keep(&files[i], &l->arena);
+    }
 
-            if (n >= n_max) {
-                n_max = n_max * 2 - n_max / 2;
+    desktop_set_labels(files, n_files, &l->arena);
+    load_publish_desktop(l, files, n_files);
 
-                *list = realloc(*list, n_max * sizeof(**list));
-                if (!*list)
-                    die("Out of memory\n");
-            }
+    blob = build_blob(dirs, n_dirs, files, n_files, &blob_size);
 
-            (*list)[n].hits = 0;
-            (*list)[n].name = strdup(entry->d_name);
+    if (cached)
+        cache_close(&c);
 
-            if (!(*list)[n].name)
-                die("Out of memory\n");
+    /*
+     * The directories added their names in the order they were done with,
+     * the desktop entries come last. The sort is stable, so an executable
+     * still takes precedence over a desktop entry of the same name.
+     */
+    for (size_t i = 0; i < n_files; ++i) {
+        if (!files[i].shown)
+            continue;
 
-            ++n;
-        }
+        store_add(store, files[i].label);
+        store_set_exec(store, store->n - 1, files[i].exec);
+    }
+
+    /*
+     * The complete list replaces the one the user interface merged from
+     * the published chunks, so the indices built from it apply there.
+     */
+    sort_store(store);
+
+    if (store->n >= LOAD_INDEX_MIN && store->n <= UINT32_MAX) {
+        index = arena_alloc(&l->arena, sizeof(*index));
+        trigram_build(index, store, &l->arena);
+
+        prefix = arena_alloc(&l->arena, sizeof(*prefix));
+        prefix_build(prefix, store, &l->arena);
+    }
+
+    /* clang-format off */
+    cache_write(cache, dirs, n_dirs, files, n_files,
+                blob, blob_size, store, index, prefix);
+    /* clang-format on */
+
+    free(blob);
+    free(files);
+    free(dirs);
+
+    load_finish(l, store, index, prefix);
+}
+
+/*
+ * The XDG data directories in which desktop entries are looked up, in
+ * order of precedence.
+ */
+static char *data_dirs(const char *home)
+{
+    const char *data_home = getenv("XDG_DATA_HOME");
+    const char *dirs = getenv("XDG_DATA_DIRS");
+    char *buf;
+    int err;
+
+    if (!dirs || dirs[0] == '\0')
+        dirs = "/usr/local/share:/usr/share";
+
+    if (data_home && data_home[0] != '\0')
+        err = asprintf(&buf, "%s:%s", data_home, dirs);
+    else
+        err = asprintf(&buf, "%s/.local/share:%s", home, dirs);
+
+    if (err < 0)
+        die("Out of memory\n");
+
+    return buf;
+}
+
+void loader_init(struct loader *l)
+{
+    queue_init(&l->queue);
+    arena_init(&l->arena);
+
+    l->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (l->event_fd < 0)
+        die_error(errno, "eventfd()");
+}
+
+static void loader_drop(void *chunk)
+{
+    load_chunk_free(chunk);
+}
+
+void loader_destroy(struct loader *l)
+{
+    close(l->event_fd);
+    queue_destroy(&l->queue, &loader_drop);
+    arena_destroy(&l->arena);
+}
+
+struct load_chunk *loader_pop(struct loader *l)
+{
+    uint64_t val;
+
+    /* Reset the event counter before looking for new chunks */
+    (void) read(l->event_fd, &val, sizeof(val));
+
+    return queue_pop(&l->queue);
+}
 
-        closedir(dir);
+/* Release a chunk along with its items */
+void load_chunk_free(struct load_chunk *chunk)
+{
+    if (chunk->store) {
+        store_destroy(chunk->store);
+        free(chunk->store);
     }
 
-    sort(*list, n);
-    n = dedup(*list, n);
+    free(chunk);
+}
+
+/*
+ * The cache is written before the last chunk is published. Block until
+ * then and drop all chunks which were not received yet.
+ */
+void loader_wait(struct loader *l)
+{
+    while (1) {
+        struct pollfd fds = { .fd = l->event_fd, .events = POLLIN };
+        struct load_chunk *chunk = loader_pop(l);
+        bool last;
+
+        if (!chunk) {
+            if (poll(&fds, 1, -1) < 0 && errno != EINTR)
+                die_error(errno, "poll()");
+
+            continue;
+        }
+
+        last = chunk->last;
+        load_chunk_free(chunk);
+
+        if (last)
+            return;
+    }
+}
 
-    cache_write(cache, path, *list, n);
+/*
+ * Without ${PATH} the directories are searched that execvp() would search,
+ * so the menu shows the commands it can start.
+ */
+const char *load_path(void)
+{
+    const char *path = getenv("PATH");
 
-    return n;
+    return path ? path : LOAD_DEFAULT_PATH;
 }
 
-size_t load(struct item **list)
+void load(struct loader *l)
 {
-    char *path, *cache;
+    char *path, *dirs, *cache;
     size_t n;
-    char *env_path = getenv("PATH");
+    const char *env_path = load_path();
     char *env_home = getenv("HOME");
 
-    if (!list)
+    if (!l)
         die("load(): Invalid argument\n");
 
-    if (!env_path)
-        die("Failed to retrieve ${PATH}\n");
-
     if (!env_home)
         die("Failed to retrieve ${HOME}\n");
 
@@ -359,5 +1960,9 @@ size_t load(struct item **list)
     strcpy(cache, env_home);
     strcpy(cache + n, "/.cache/wlmenu/cache");
 
-    return do_load(path, cache, list);
+    dirs = data_dirs(env_home);
+
+    do_load(path, dirs, cache, l);
+
+    free(dirs);
 }
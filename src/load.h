@@ -25,13 +25,53 @@
 #ifndef LOAD_H_
 #define LOAD_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
-struct item {
-    char *name;
-    size_t hits;
+#include "arena.h"
+#include "queue.h"
+
+/* Minimum number of items for which the trigram and prefix index are built */
+#define LOAD_INDEX_MIN 1024
+
+struct prefix_index;
+struct store;
+struct trigram_index;
+
+/*
+ * Sorted items published by the loader. The last chunk holds the complete
+ * list, which may come with its trigram and prefix index.
+ */
+struct load_chunk {
+    struct store *store;
+    bool last;
+
+    const struct trigram_index *index;
+    const struct prefix_index *prefix;
+};
+
+struct loader {
+    struct queue queue;
+    struct arena arena;
+    int event_fd;
 };
 
-size_t load(struct item **list);
+void loader_init(struct loader *l);
+
+void loader_destroy(struct loader *l);
+
+struct load_chunk *loader_pop(struct loader *l);
+
+void load_chunk_free(struct load_chunk *chunk);
+
+void loader_wait(struct loader *l);
+
+void load(struct loader *l);
+
+const char *load_path(void);
+
+int load_compare(const char *a, const char *b);
+
+bool load_is_item(int fd, const char *name);
 
 #endif /* LOAD_H_ */
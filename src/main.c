@@ -24,6 +24,7 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <getopt.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -37,72 +38,92 @@
 #include "wlmenu.h"
 
 static struct wlmenu wlmenu;
-static struct item *list;
-static size_t size;
+static struct loader loader;
 
 static void *thr_load(void *arg)
 {
     (void) arg;
 
-    size = load(&list);
+    load(&loader);
 
     return NULL;
 }
 
-static void match(const char *str, struct item *list, size_t size)
+static char *history_path(void)
 {
-    size_t len = strlen(str);
-    if (!len)
-        return;
+    const char *state_home = getenv("XDG_STATE_HOME");
+    const char *home = getenv("HOME");
+    char *path;
+    int err;
 
-    for (size_t i = 0; i < size; ++i) {
-        int diff = (unsigned int) len - list[i].hits;
+    if (state_home && state_home[0] != '\0')
+        err = asprintf(&path, "%s/wlmenu/history", state_home);
+    else if (home)
+        err = asprintf(&path, "%s/.local/state/wlmenu/history", home);
+    else
+        return NULL;
 
-        if (abs(diff) == 1 && strstr(list[i].name, str))
-            list[i].hits = (unsigned int) len;
-    }
+    if (err < 0)
+        die("Out of memory\n");
+
+    return path;
 }
 
-#if 0
-static int make_directories(const char *path, mode_t mode)
+static void usage(const char *name)
 {
-
-    char *dup = strdupa(path);
-    
-    for (char *p = dup; *p != '\0'; ++p) {
-        if (*p == '/') {
-            int err;
-
-            *p = '\0';
-
-            err = mkdir(dup, mode);
-            if (err < 0 && errno != EEXIST)
-                return -errno;
-
-            *p = '/';
-
-            while (*p != 0 && *p++ == '/')
-                ;
-        }
-    }
-
-    return 0;
+    fprintf(stderr,
+            "Usage: %s [OPTION]...\n"
+            "Run a command or pick one line of the standard input.\n"
+            "\n"
+            "  -d, --dmenu    read the items from stdin and print the\n"
+            "                 selected one to stdout\n"
+            "  -f, --fuzzy    match the input as a subsequence of the\n"
+            "                 items instead of a substring\n"
+            "  -h, --help     display this help and exit\n"
+            "\n"
+            "Input starting with '/' is matched as a regular expression.\n",
+            name);
 }
-#endif
 
 int main(int argc, char *argv[])
 {
+    static const struct option options[] = {
+        { "dmenu", no_argument, NULL, 'd' },
+        { "fuzzy", no_argument, NULL, 'f' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
     struct widget *widget;
     pthread_t thread;
-    int err;
+    char *history = NULL;
+    enum match_mode mode = MATCH_SUBSTRING;
+    bool dmenu = false;
+    int c, err;
+
+    while ((c = getopt_long(argc, argv, "dfh", options, NULL)) != -1) {
+        switch (c) {
+        case 'd':
+            dmenu = true;
+            break;
+        case 'f':
+            mode = MATCH_FUZZY;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
 
-    (void) argc;
-    (void) argv;
-    (void) &match;
+    if (!dmenu) {
+        loader_init(&loader);
 
-    err = pthread_create(&thread, NULL, &thr_load, NULL);
-    if (err < 0)
-        die("Failed to load runnable applications\n");
+        err = pthread_create(&thread, NULL, &thr_load, NULL);
+        if (err != 0)
+            die("Failed to load runnable applications\n");
+    }
 
     wlmenu_init(&wlmenu, NULL);
     wlmenu_set_window_title(&wlmenu, "wlmenu");
@@ -115,18 +136,36 @@ int main(int argc, char *argv[])
     widget_set_font_size(widget, 16.0);
     widget_set_max_rows(widget, 12);
 
-    wlmenu_show(&wlmenu);
+    wlmenu_set_match_mode(&wlmenu, mode);
 
-    (void) pthread_join(thread, NULL);
+    if (dmenu) {
+        wlmenu_set_input(&wlmenu, STDIN_FILENO);
+    } else {
+        history = history_path();
+        if (history)
+            wlmenu_set_history(&wlmenu, history);
 
-    wlmenu_set_items(&wlmenu, list, size);
+        wlmenu_set_loader(&wlmenu, &loader);
+        wlmenu_watch_dirs(&wlmenu, load_path());
+    }
+
+    wlmenu_show(&wlmenu);
 
-    printf("Entering dispatch mode\n");
+    /* stdout is reserved for the selected item */
+    fprintf(stderr, "Entering dispatch mode\n");
 
     wlmenu_mainloop(&wlmenu);
 
+    if (!dmenu)
+        (void) pthread_join(thread, NULL);
+
     wlmenu_destroy(&wlmenu);
-    fprintf(stdout, "Goodbye!\n");
+    free(history);
+
+    if (!dmenu)
+        loader_destroy(&loader);
+
+    fprintf(stderr, "Goodbye!\n");
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,720 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include "proc-util.h"
+
+#include "match.h"
+#include "utf8.h"
+
+/*
+ * The vector kernels load whole blocks which may extend past the end of
+ * the string. The blocks at 'str' and 'str + len - 1' are only loaded if
+ * both lie in the page of 'str', which is known to be mapped. Near the end
+ * of a page, the remaining part of the string is searched by the scalar
+ * kernel.
+ */
+#define MATCH_PAGE_SIZE 4096
+
+#define NO_SANITIZE __attribute__((no_sanitize_address, no_sanitize_thread))
+
+static inline bool page_safe(const char *p, size_t size)
+{
+    uintptr_t offset = (uintptr_t) p & (MATCH_PAGE_SIZE - 1);
+
+    return size <= MATCH_PAGE_SIZE && offset <= MATCH_PAGE_SIZE - size;
+}
+
+/* Compare the characters of the needle between its first and last one */
+static inline bool match_at(const struct match_query *q, const char *str)
+{
+    for (size_t i = 1; i + 1 < q->len; ++i) {
+        if (str[i] != q->str[i])
+            return false;
+    }
+
+    return true;
+}
+
+static bool match_find_scalar(const struct match_query *q, const char *str)
+{
+    char first = q->str[0];
+
+    for (; *str != '\0'; ++str) {
+        size_t i = 1;
+
+        if (*str != first)
+            continue;
+
+        /* Stops at the end of 'str' at the latest */
+        while (i < q->len && str[i] == q->str[i])
+            ++i;
+
+        if (i == q->len)
+            return true;
+    }
+
+    return false;
+}
+
+#ifdef __SSE2__
+/*
+ * Search 16 possible starting positions at once: A position is a candidate
+ * if both the first and the last character of the needle match there.
+ * Only the characters in between of the candidates are compared one by one.
+ */
+NO_SANITIZE static bool
+match_find_sse2(const struct match_query *q, const char *str)
+{
+    const size_t n = q->len - 1;
+    const __m128i first = _mm_set1_epi8(q->str[0]);
+    const __m128i last = _mm_set1_epi8(q->str[n]);
+    const __m128i zero = _mm_setzero_si128();
+
+    while (page_safe(str, n + 16)) {
+        __m128i a = _mm_loadu_si128((const __m128i *) str);
+        __m128i b = _mm_loadu_si128((const __m128i *) (str + n));
+        unsigned int end, mask;
+
+        mask = (unsigned int) _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+        /* Stop at the terminating null byte */
+        end = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(a, zero));
+        if (end)
+            mask &= (end & -end) - 1;
+
+        while (mask) {
+            int i = __builtin_ctz(mask);
+
+            if (match_at(q, str + i))
+                return true;
+
+            mask &= mask - 1;
+        }
+
+        if (end)
+            return false;
+
+        str += 16;
+    }
+
+    return match_find_scalar(q, str);
+}
+
+__attribute__((target("avx2"))) NO_SANITIZE static bool
+match_find_avx2(const struct match_query *q, const char *str)
+{
+    const size_t n = q->len - 1;
+    const __m256i first = _mm256_set1_epi8(q->str[0]);
+    const __m256i last = _mm256_set1_epi8(q->str[n]);
+    const __m256i zero = _mm256_setzero_si256();
+
+    while (page_safe(str, n + 32)) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) str);
+        __m256i b = _mm256_loadu_si256((const __m256i *) (str + n));
+        unsigned int end, mask;
+
+        mask = (unsigned int) _mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+
+        /* Stop at the terminating null byte */
+        end = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, zero));
+        if (end)
+            mask &= (end & -end) - 1;
+
+        while (mask) {
+            int i = __builtin_ctz(mask);
+
+            if (match_at(q, str + i))
+                return true;
+
+            mask &= mask - 1;
+        }
+
+        if (end)
+            return false;
+
+        str += 32;
+    }
+
+    return match_find_scalar(q, str);
+}
+#endif
+
+/*
+ * Bytes which do not start a valid sequence stand for themselves. They are
+ * moved out of the range of Unicode, so they never equal a character.
+ */
+#define MATCH_INVALID_CHAR 0x110000
+
+/*
+ * Decode the character at the start of the null-terminated 'str' into 'c'
+ * and return its length. No sequence extends past the terminator, since it
+ * is not a continuation byte.
+ */
+static inline size_t match_char(const char *str, uint32_t *c)
+{
+    size_t n;
+
+    if ((unsigned char) *str < 0x80) {
+        *c = (unsigned char) *str;
+        return 1;
+    }
+
+    n = utf8_decode(str, 4, c);
+    if (!n) {
+        *c = MATCH_INVALID_CHAR | (unsigned char) *str;
+        n = 1;
+    }
+
+    return n;
+}
+
+/*
+ * Fuzzy matching: Every character of the needle has to appear in 'str' in
+ * the same order. This is only a cheap test which rejects most items
+ * before they are scored.
+ */
+static bool match_find_fuzzy(const struct match_query *q, const char *str)
+{
+    size_t i = 0;
+
+    while (*str != '\0') {
+        uint32_t c;
+
+        str += match_char(str, &c);
+
+        if (c == q->chars[i] && ++i == q->n_chars)
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * The score of a fuzzy match is computed like fzf does: Every matched
+ * character scores, more so if it starts a word or follows another
+ * matched character. Gaps between matched characters cost a little.
+ */
+#define SCORE_MATCH 16
+#define SCORE_GAP_START (-3)
+#define SCORE_GAP_EXTENSION (-1)
+#define BONUS_BOUNDARY 8
+#define BONUS_CAMEL 7
+#define BONUS_CONSECUTIVE 4
+#define BONUS_FIRST_CHAR_MULTIPLIER 2
+
+/* Longest part of an item which is scored by the alignment */
+#define MATCH_FUZZY_MAX 256
+
+#define SCORE_NONE (-(1 << 24))
+
+enum char_class {
+    CHAR_DELIMITER,
+    CHAR_LOWER,
+    CHAR_UPPER,
+    CHAR_DIGIT,
+    CHAR_OTHER,
+};
+
+/* Characters outside of ASCII are never delimiters and have no case */
+static enum char_class char_class(uint32_t c)
+{
+    if (c >= 'a' && c <= 'z')
+        return CHAR_LOWER;
+
+    if (c >= 'A' && c <= 'Z')
+        return CHAR_UPPER;
+
+    if (c >= '0' && c <= '9')
+        return CHAR_DIGIT;
+
+    if (c == '\0' || (c < 0x80 && strchr(" \t/,:;|-_.", (int) c)))
+        return CHAR_DELIMITER;
+
+    return CHAR_OTHER;
+}
+
+/* Bonus for matching a character of class 'cur' which follows 'prev' */
+static int match_bonus(enum char_class prev, enum char_class cur)
+{
+    if (cur == CHAR_DELIMITER)
+        return 0;
+
+    if (prev == CHAR_DELIMITER)
+        return BONUS_BOUNDARY;
+
+    if (prev == CHAR_LOWER && cur == CHAR_UPPER)
+        return BONUS_CAMEL;
+
+    if (prev != CHAR_DIGIT && cur == CHAR_DIGIT)
+        return BONUS_CAMEL;
+
+    return 0;
+}
+
+/*
+ * Decode the next character of 'folded' into 'c' and return its length.
+ * Its bonus depends on the class of the same character in 'str' and on
+ * the class 'prev' of the one in front of it, which is advanced.
+ */
+static size_t match_next(const char *str,
+                         const char *folded,
+                         uint32_t *c,
+                         enum char_class *prev,
+                         int *bonus)
+{
+    size_t n = match_char(folded, c);
+    enum char_class cur;
+    uint32_t orig;
+
+    /* Folding keeps the length of every character */
+    match_char(str, &orig);
+    cur = char_class(orig);
+
+    *bonus = match_bonus(*prev, cur);
+    *prev = cur;
+
+    return n;
+}
+
+static int max(int a, int b)
+{
+    return (a > b) ? a : b;
+}
+
+/*
+ * Score the best alignment of the needle within 'str', which is 'len'
+ * bytes long and compared by its folded form 'folded'. Both are compared
+ * by characters. Row i of the table holds the best score of matching the
+ * first i + 1 characters of the needle with the last one matched at the
+ * given position. Only two rows are kept at a time.
+ */
+static int match_score_fuzzy(const struct match_query *q,
+                             const char *str,
+                             const char *folded,
+                             size_t len)
+{
+    int rows[2][MATCH_FUZZY_MAX], bonus[MATCH_FUZZY_MAX];
+    uint32_t chars[MATCH_FUZZY_MAX];
+    int *prev = rows[0], *cur = rows[1];
+    enum char_class class = CHAR_DELIMITER;
+    int best = SCORE_NONE;
+    size_t n = 0;
+
+    for (size_t j = 0; j < len; ++n) {
+        j += match_next(str + j, folded + j, &chars[n], &class, &bonus[n]);
+
+        prev[n] = SCORE_NONE;
+        if (chars[n] == q->chars[0])
+            prev[n] = SCORE_MATCH + bonus[n] * BONUS_FIRST_CHAR_MULTIPLIER;
+    }
+
+    for (size_t i = 1; i < q->n_chars; ++i) {
+        int gap = SCORE_NONE;
+        int *tmp;
+
+        cur[0] = SCORE_NONE;
+
+        for (size_t j = 1; j < n; ++j) {
+            int score;
+
+            /* Best alignment whose last match is at least two back */
+            if (j >= 2)
+                gap = max(gap + SCORE_GAP_EXTENSION,
+                          prev[j - 2] + SCORE_GAP_START);
+
+            cur[j] = SCORE_NONE;
+
+            if (chars[j] != q->chars[i])
+                continue;
+
+            score = max(prev[j - 1] + BONUS_CONSECUTIVE, gap);
+            if (score <= SCORE_NONE / 2)
+                continue;
+
+            cur[j] = score + SCORE_MATCH + bonus[j];
+        }
+
+        tmp = prev;
+        prev = cur;
+        cur = tmp;
+    }
+
+    for (size_t j = 0; j < n; ++j)
+        best = max(best, prev[j]);
+
+    return best;
+}
+
+/*
+ * Items which are too long for the alignment get a greedy score: The
+ * characters are matched at their first occurrence.
+ */
+static int match_score_greedy(const struct match_query *q,
+                              const char *str,
+                              const char *folded)
+{
+    enum char_class class = CHAR_DELIMITER;
+    int score = 0, gap = 0;
+    size_t i = 0, j = 0;
+
+    while (str[j] != '\0' && i < q->n_chars) {
+        uint32_t c;
+        int bonus;
+
+        j += match_next(str + j, folded + j, &c, &class, &bonus);
+
+        if (c != q->chars[i]) {
+            gap += (i && !gap) ? SCORE_GAP_START : SCORE_GAP_EXTENSION;
+            continue;
+        }
+
+        score += SCORE_MATCH + bonus + ((i) ? gap : 0);
+
+        if (i && !gap)
+            score += BONUS_CONSECUTIVE;
+
+        gap = 0;
+        ++i;
+    }
+
+    return score;
+}
+
+static bool match_prefix(const struct match_query *q, const char *folded)
+{
+    return strncmp(folded, q->str, q->len) == 0;
+}
+
+/*
+ * Where a substring match starts in 'str': At its very beginning, at the
+ * beginning of any word or somewhere else. Words are told apart by the
+ * case of 'str', while its folded form 'folded' is searched.
+ */
+enum match_class match_query_class(const struct match_query *q,
+                                   const char *str,
+                                   const char *folded)
+{
+    /* A regular expression does not tell where it matched */
+    if (q->mode == MATCH_REGEX)
+        return MATCH_INNER;
+
+    if (match_prefix(q, folded))
+        return MATCH_PREFIX;
+
+    for (size_t i = 1; str[i] != '\0'; ++i) {
+        enum char_class prev = char_class((unsigned char) str[i - 1]);
+        enum char_class cur = char_class((unsigned char) str[i]);
+
+        if (match_bonus(prev, cur) && match_prefix(q, folded + i))
+            return MATCH_WORD;
+    }
+
+    return MATCH_INNER;
+}
+
+/*
+ * Score of an item which matches the query, higher is better. Only fuzzy
+ * matches are scored.
+ */
+int match_query_score(const struct match_query *q,
+                      const char *str,
+                      const char *folded)
+{
+    size_t len;
+
+    if (q->mode != MATCH_FUZZY || !q->n_chars)
+        return 0;
+
+    len = strlen(str);
+    if (len > MATCH_FUZZY_MAX)
+        return match_score_greedy(q, str, folded);
+
+    return match_score_fuzzy(q, str, folded, len);
+}
+
+static bool match_find_empty(const struct match_query *q, const char *str)
+{
+    (void) q;
+    (void) str;
+
+    return true;
+}
+
+static bool match_find_none(const struct match_query *q, const char *str)
+{
+    (void) q;
+    (void) str;
+
+    return false;
+}
+
+static bool match_find_regex(const struct match_query *q, const char *str)
+{
+    return dfa_match(q->dfa, str);
+}
+
+void match_query_init(struct match_query *q)
+{
+    q->str = NULL;
+    q->len = 0;
+    q->size = 0;
+    q->mode = MATCH_SUBSTRING;
+    q->dfa = NULL;
+    q->chars = NULL;
+    q->n_chars = 0;
+    q->min_len = 0;
+    q->find = &match_find_empty;
+}
+
+void match_query_destroy(struct match_query *q)
+{
+    dfa_free(q->dfa);
+    free(q->chars);
+    free(q->str);
+}
+
+void match_query_set(struct match_query *q,
+                     const char *str,
+                     size_t len,
+                     enum match_mode mode)
+{
+    if (len + 1 > q->size) {
+        q->size = len + 1;
+
+        q->str = realloc(q->str, q->size);
+        q->chars = realloc(q->chars, q->size * sizeof(*q->chars));
+        if (!q->str || !q->chars)
+            die("Out of memory\n");
+    }
+
+    /* The escapes of an expression keep their case */
+    if (mode == MATCH_REGEX)
+        dfa_fold(q->str, str, len);
+    else
+        utf8_fold(q->str, str, len);
+
+    q->str[len] = '\0';
+    q->len = len;
+    q->mode = mode;
+    q->min_len = len;
+
+    dfa_free(q->dfa);
+    q->dfa = NULL;
+
+    if (!len) {
+        q->find = &match_find_empty;
+        return;
+    }
+
+    /* An invalid expression, e.g. one still being typed, matches nothing */
+    if (mode == MATCH_REGEX) {
+        q->dfa = dfa_compile(q->str, len);
+        q->find = (q->dfa) ? &match_find_regex : &match_find_none;
+        q->min_len = 0;
+        return;
+    }
+
+    /*
+     * The needle of a fuzzy query is matched by characters. A character
+     * cut off at its end by a shorter prefix of the input is left out.
+     */
+    if (mode == MATCH_FUZZY) {
+        size_t end = utf8_complete_len(q->str, len);
+
+        q->n_chars = 0;
+
+        for (size_t i = 0; i < end; ++q->n_chars)
+            i += match_char(q->str + i, &q->chars[q->n_chars]);
+
+        q->find = (q->n_chars) ? &match_find_fuzzy : &match_find_empty;
+        return;
+    }
+
+#ifdef __SSE2__
+    if (__builtin_cpu_supports("avx2"))
+        q->find = &match_find_avx2;
+    else
+        q->find = &match_find_sse2;
+#else
+    q->find = &match_find_scalar;
+#endif
+}
+
+void match_stack_init(struct match_stack *s)
+{
+    s->levels = NULL;
+    s->depth = 0;
+    s->n_max = 0;
+    s->mode = MATCH_SUBSTRING;
+}
+
+void match_stack_destroy(struct match_stack *s)
+{
+    for (size_t i = 0; i < s->n_max; ++i)
+        match_level_destroy(&s->levels[i]);
+
+    free(s->levels);
+}
+
+struct match_level *match_stack_top(struct match_stack *s)
+{
+    return (s->depth) ? &s->levels[s->depth - 1] : NULL;
+}
+
+struct match_level *
+match_stack_push(struct match_stack *s, const char *str, size_t len)
+{
+    struct match_level *level;
+
+    if (s->depth == s->n_max) {
+        size_t n_max = (s->n_max) ? s->n_max * 2 : 16;
+
+        s->levels = realloc(s->levels, n_max * sizeof(*s->levels));
+        if (!s->levels)
+            die("Out of memory\n");
+
+        for (size_t i = s->n_max; i < n_max; ++i)
+            match_level_init(&s->levels[i]);
+
+        s->n_max = n_max;
+    }
+
+    level = &s->levels[s->depth++];
+    level->n = 0;
+
+    match_query_set(&level->query, str, len, s->mode);
+
+    return level;
+}
+
+void match_stack_pop(struct match_stack *s)
+{
+    if (s->depth)
+        --s->depth;
+}
+
+void match_stack_clear(struct match_stack *s)
+{
+    s->depth = 0;
+}
+
+void match_stack_set_mode(struct match_stack *s, enum match_mode mode)
+{
+    s->mode = mode;
+    s->depth = 0;
+}
+
+/*
+ * Number of levels which are still valid for the folded input 'str', i.e.
+ * the length of the common prefix of 'str' and the input of the topmost
+ * level.
+ */
+size_t match_stack_common_len(const struct match_stack *s,
+                              const char *str,
+                              size_t len)
+{
+    const struct match_query *q;
+    size_t i = 0;
+
+    if (!s->depth)
+        return 0;
+
+    q = &s->levels[s->depth - 1].query;
+
+    while (i < len && i < q->len && str[i] == q->str[i])
+        ++i;
+
+    return i;
+}
+
+/*
+ * Number of levels matched by the folded string 'str'. A string which
+ * contains a prefix of the input also contains all shorter ones, so this is
+ * a binary search.
+ */
+size_t match_stack_match_len(const struct match_stack *s, const char *str)
+{
+    size_t low = 0, high = s->depth;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if (match_query_find(&s->levels[mid].query, str))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+void match_level_init(struct match_level *l)
+{
+    match_query_init(&l->query);
+    l->index = NULL;
+    l->n = 0;
+    l->n_max = 0;
+}
+
+void match_level_destroy(struct match_level *l)
+{
+    match_query_destroy(&l->query);
+    free(l->index);
+}
+
+/* Make room for at least 'n' candidates in total */
+void match_level_reserve(struct match_level *l, size_t n)
+{
+    if (n <= l->n_max)
+        return;
+
+    l->index = realloc(l->index, n * sizeof(*l->index));
+    if (!l->index)
+        die("Out of memory\n");
+
+    l->n_max = n;
+}
+
+void match_level_add(struct match_level *l, size_t index)
+{
+    if (l->n == l->n_max) {
+        l->n_max = (l->n_max) ? l->n_max * 2 - l->n_max / 2 : 64;
+
+        l->index = realloc(l->index, l->n_max * sizeof(*l->index));
+        if (!l->index)
+            die("Out of memory\n");
+    }
+
+    l->index[l->n++] = index;
+}
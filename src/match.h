@@ -0,0 +1,150 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MATCH_H_
+#define MATCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dfa.h"
+
+enum match_mode {
+    /* The input has to be a substring of the item */
+    MATCH_SUBSTRING,
+    /* The characters of the input have to appear in order in the item */
+    MATCH_FUZZY,
+    /* The input is a regular expression which has to match the item */
+    MATCH_REGEX,
+};
+
+/* Position of a substring match, better matches compare greater */
+enum match_class {
+    MATCH_INNER,
+    MATCH_WORD,
+    MATCH_PREFIX,
+};
+
+/*
+ * Case-insensitive search for one query. The needle is folded by
+ * utf8_fold() once and the fastest search kernel supported by the CPU is
+ * picked when the query is set up. Strings searched for the needle have to
+ * be folded the same way. A regular expression is compiled into a DFA
+ * instead.
+ */
+struct match_query {
+    char *str;
+    size_t len;
+    size_t size;
+
+    enum match_mode mode;
+    struct dfa *dfa;
+
+    /* Characters of a fuzzy needle, which is matched one at a time */
+    uint32_t *chars;
+    size_t n_chars;
+
+    /* Strings shorter than this never match */
+    size_t min_len;
+
+    bool (*find)(const struct match_query *q, const char *str);
+};
+
+/* Indices of the items which match one prefix of the input */
+struct match_level {
+    struct match_query query;
+
+    size_t *index;
+    size_t n;
+    size_t n_max;
+};
+
+/*
+ * Candidate stack of the incremental search: 'levels[k]' holds the items
+ * matching the first k + 1 characters of the input. Typing a character
+ * only filters the topmost level and removing one pops it. Popped levels
+ * keep their memory for the next push.
+ */
+struct match_stack {
+    struct match_level *levels;
+    size_t depth;
+    size_t n_max;
+
+    enum match_mode mode;
+};
+
+void match_query_init(struct match_query *q);
+
+void match_query_destroy(struct match_query *q);
+
+void match_query_set(struct match_query *q,
+                     const char *str,
+                     size_t len,
+                     enum match_mode mode);
+
+static inline bool
+match_query_find(const struct match_query *q, const char *str)
+{
+    return q->find(q, str);
+}
+
+enum match_class match_query_class(const struct match_query *q,
+                                   const char *str,
+                                   const char *folded);
+
+int match_query_score(const struct match_query *q,
+                      const char *str,
+                      const char *folded);
+
+void match_stack_init(struct match_stack *s);
+
+void match_stack_destroy(struct match_stack *s);
+
+struct match_level *match_stack_top(struct match_stack *s);
+
+struct match_level *
+match_stack_push(struct match_stack *s, const char *str, size_t len);
+
+void match_stack_pop(struct match_stack *s);
+
+void match_stack_clear(struct match_stack *s);
+
+void match_stack_set_mode(struct match_stack *s, enum match_mode mode);
+
+size_t match_stack_common_len(const struct match_stack *s,
+                              const char *str,
+                              size_t len);
+
+size_t match_stack_match_len(const struct match_stack *s, const char *str);
+
+void match_level_init(struct match_level *l);
+
+void match_level_destroy(struct match_level *l);
+
+void match_level_reserve(struct match_level *l, size_t n);
+
+void match_level_add(struct match_level *l, size_t index);
+
+#endif /* MATCH_H_ */
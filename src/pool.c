@@ -0,0 +1,161 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+
+#include "pool.h"
+#include "proc-util.h"
+
+static void pool_work(struct pool *p)
+{
+    size_t i;
+
+    while ((i = atomic_fetch_add(&p->next, 1)) < p->n_tasks)
+        p->func(p->arg, i);
+}
+
+static void *pool_thread(void *arg)
+{
+    struct pool *p = arg;
+    unsigned long generation = 0;
+
+    pthread_mutex_lock(&p->mutex);
+
+    while (1) {
+        while (!p->quit && p->generation == generation)
+            pthread_cond_wait(&p->cond_work, &p->mutex);
+
+        if (p->quit)
+            break;
+
+        generation = p->generation;
+
+        pthread_mutex_unlock(&p->mutex);
+
+        pool_work(p);
+
+        pthread_mutex_lock(&p->mutex);
+
+        if (--p->n_busy == 0)
+            pthread_cond_signal(&p->cond_done);
+    }
+
+    pthread_mutex_unlock(&p->mutex);
+
+    return NULL;
+}
+
+void pool_init(struct pool *p, size_t n_threads)
+{
+    int err;
+
+    p->n_threads = 0;
+    p->func = NULL;
+    p->arg = NULL;
+    p->n_tasks = 0;
+    p->generation = 0;
+    p->n_busy = 0;
+    p->quit = false;
+
+    atomic_init(&p->next, 0);
+
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->cond_work, NULL);
+    pthread_cond_init(&p->cond_done, NULL);
+
+    p->threads = malloc(n_threads * sizeof(*p->threads));
+    if (n_threads && !p->threads)
+        die("Out of memory\n");
+
+    for (size_t i = 0; i < n_threads; ++i) {
+        err = pthread_create(&p->threads[i], NULL, &pool_thread, p);
+        if (err != 0)
+            die_error(err, "Failed to create worker thread");
+
+        ++p->n_threads;
+    }
+}
+
+void pool_destroy(struct pool *p)
+{
+    pthread_mutex_lock(&p->mutex);
+    p->quit = true;
+    pthread_cond_broadcast(&p->cond_work);
+    pthread_mutex_unlock(&p->mutex);
+
+    for (size_t i = 0; i < p->n_threads; ++i)
+        (void) pthread_join(p->threads[i], NULL);
+
+    pthread_cond_destroy(&p->cond_done);
+    pthread_cond_destroy(&p->cond_work);
+    pthread_mutex_destroy(&p->mutex);
+
+    free(p->threads);
+}
+
+size_t pool_size(const struct pool *p)
+{
+    /* The calling thread always takes part in the work */
+    return p->n_threads + 1;
+}
+
+void pool_run(struct pool *p,
+              size_t n_tasks,
+              void (*func)(void *arg, size_t i),
+              void *arg)
+{
+    if (!n_tasks)
+        return;
+
+    /* Not worth waking up anyone else */
+    if (n_tasks == 1 || !p->n_threads) {
+        for (size_t i = 0; i < n_tasks; ++i)
+            func(arg, i);
+
+        return;
+    }
+
+    pthread_mutex_lock(&p->mutex);
+
+    p->func = func;
+    p->arg = arg;
+    p->n_tasks = n_tasks;
+    atomic_store(&p->next, 0);
+
+    p->n_busy = p->n_threads;
+    ++p->generation;
+
+    pthread_cond_broadcast(&p->cond_work);
+    pthread_mutex_unlock(&p->mutex);
+
+    pool_work(p);
+
+    pthread_mutex_lock(&p->mutex);
+
+    while (p->n_busy)
+        pthread_cond_wait(&p->cond_done, &p->mutex);
+
+    pthread_mutex_unlock(&p->mutex);
+}
@@ -0,0 +1,98 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "prefix.h"
+
+static int prefix_compare(const void *a, const void *b, void *arg)
+{
+    const struct store *names = arg;
+    uint32_t i = *(const uint32_t *) a, j = *(const uint32_t *) b;
+    int diff;
+
+    diff = strcmp(store_folded(names, i), store_folded(names, j));
+    if (diff)
+        return diff;
+
+    return (i > j) - (i < j);
+}
+
+/* Build the index of 'names', its memory is allocated from 'arena' */
+void prefix_build(struct prefix_index *p,
+                  const struct store *names,
+                  struct arena *arena)
+{
+    size_t n = names->n;
+    uint32_t *index = arena_alloc(arena, n * sizeof(*index));
+
+    for (size_t i = 0; i < n; ++i)
+        index[i] = (uint32_t) i;
+
+    qsort_r(index, n, sizeof(*index), &prefix_compare, (void *) names);
+
+    p->index = index;
+    p->n = n;
+}
+
+static size_t prefix_bound(const struct prefix_index *p,
+                           const struct store *names,
+                           const char *str,
+                           size_t len,
+                           int limit)
+{
+    size_t low = 0, high = p->n;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const char *name = store_folded(names, p->index[mid]);
+
+        if (strncmp(name, str, len) < limit)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/*
+ * Look up the range of the names starting with the first 'len' characters
+ * of the folded string 'str'. Returns the number of such names, the first
+ * of them is stored at 'first'.
+ */
+size_t prefix_range(const struct prefix_index *p,
+                    const struct store *names,
+                    const char *str,
+                    size_t len,
+                    size_t *first)
+{
+    size_t end;
+
+    *first = prefix_bound(p, names, str, len, 0);
+    end = prefix_bound(p, names, str, len, 1);
+
+    return end - *first;
+}
@@ -0,0 +1,93 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+
+#include "proc-util.h"
+#include "queue.h"
+
+static struct queue_node *queue_new_node(void *data)
+{
+    struct queue_node *node = malloc(sizeof(*node));
+    if (!node)
+        die("Out of memory\n");
+
+    atomic_init(&node->next, NULL);
+    node->data = data;
+
+    return node;
+}
+
+void queue_init(struct queue *q)
+{
+    /* The head always points to an already consumed node */
+    q->head = queue_new_node(NULL);
+    atomic_init(&q->tail, q->head);
+}
+
+void queue_destroy(struct queue *q, void (*func)(void *))
+{
+    void *data;
+
+    while ((data = queue_pop(q))) {
+        if (func)
+            func(data);
+    }
+
+    free(q->head);
+}
+
+void queue_push(struct queue *q, void *data)
+{
+    struct queue_node *node = queue_new_node(data);
+    struct queue_node *prev;
+
+    prev = atomic_exchange_explicit(&q->tail, node, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+/*
+ * Returns NULL if the queue is empty. A push which is still in progress
+ * might not be visible yet, so producers have to notify the consumer
+ * only after queue_push() returned.
+ */
+void *queue_pop(struct queue *q)
+{
+    struct queue_node *head = q->head;
+    struct queue_node *next;
+    void *data;
+
+    next = atomic_load_explicit(&head->next, memory_order_acquire);
+    if (!next)
+        return NULL;
+
+    data = next->data;
+    next->data = NULL;
+    q->head = next;
+
+    free(head);
+
+    return data;
+}
@@ -0,0 +1,53 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef QUEUE_H_
+#define QUEUE_H_
+
+#include <stdatomic.h>
+
+struct queue_node {
+    struct queue_node *_Atomic next;
+    void *data;
+};
+
+/*
+ * Unbounded lock-free queue: Any number of threads may push, but only a
+ * single thread may pop elements.
+ */
+struct queue {
+    struct queue_node *head;
+    struct queue_node *_Atomic tail;
+};
+
+void queue_init(struct queue *q);
+
+void queue_destroy(struct queue *q, void (*func)(void *));
+
+void queue_push(struct queue *q, void *data);
+
+void *queue_pop(struct queue *q);
+
+#endif /* QUEUE_H_ */
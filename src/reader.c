@@ -0,0 +1,129 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "proc-util.h"
+#include "reader.h"
+
+#define READER_BLOCK_SIZE (1024 * 1024)
+
+/*
+ * Upper limit of the input: Items are addressed with 32 bit offsets, so
+ * there is no use in reading more. Smaller address spaces may not be able
+ * to reserve that much.
+ */
+#define READER_MAX_SIZE                                                        \
+    ((SIZE_MAX > UINT32_MAX) ? (size_t) UINT32_MAX + 1 : (size_t) 1 << 28)
+
+void reader_init(struct reader *r)
+{
+    const int prot = PROT_READ | PROT_WRITE;
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    size_t size = READER_MAX_SIZE;
+
+    r->buf = MAP_FAILED;
+
+    while (r->buf == MAP_FAILED && size >= READER_BLOCK_SIZE) {
+        r->buf = mmap(NULL, size, prot, flags, -1, 0);
+        if (r->buf == MAP_FAILED)
+            size /= 2;
+    }
+
+    if (r->buf == MAP_FAILED)
+        die("Out of memory\n");
+
+    r->size = size;
+    r->len = 0;
+    r->line = 0;
+}
+
+void reader_destroy(struct reader *r)
+{
+    if (r->buf && r->buf != MAP_FAILED)
+        munmap(r->buf, r->size);
+}
+
+/*
+ * Read the next piece of input from 'fd' and pass every completed line and
+ * its length to 'func'. Returns the number of bytes read, 0 at the end of
+ * the input (after passing the last line, if it lacks a newline) or a
+ * negative error code, e.g. -EAGAIN if 'fd' is non-blocking and no input
+ * is available or -EFBIG if the input does not fit into the buffer. One
+ * byte is always kept free for terminating the last line of the input.
+ */
+ssize_t reader_read(struct reader *r,
+                    int fd,
+                    void (*func)(char *line, size_t len, void *arg),
+                    void *arg)
+{
+    size_t n = r->size - r->len - 1;
+    char *p, *end;
+    ssize_t size;
+
+    if (!n)
+        return -EFBIG;
+
+    if (n > READER_BLOCK_SIZE)
+        n = READER_BLOCK_SIZE;
+
+    do {
+        size = read(fd, r->buf + r->len, n);
+    } while (size < 0 && errno == EINTR);
+
+    if (size < 0)
+        return -errno;
+
+    if (!size) {
+        if (r->line < r->len) {
+            r->buf[r->len] = '\0';
+            func(r->buf + r->line, r->len - r->line, arg);
+
+            /* The terminator now belongs to the line */
+            r->line = ++r->len;
+        }
+
+        return 0;
+    }
+
+    p = r->buf + r->len;
+    end = p + size;
+
+    while ((p = memchr(p, '\n', (size_t) (end - p)))) {
+        size_t line = (size_t) (p - r->buf);
+
+        *p++ = '\0';
+
+        func(r->buf + r->line, line - r->line, arg);
+        r->line = line + 1;
+    }
+
+    r->len += (size_t) size;
+
+    return size;
+}
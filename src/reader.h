@@ -0,0 +1,56 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef READER_H_
+#define READER_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Splits a stream into lines without copying them: The input is read into
+ * one large buffer and every newline is replaced with a null byte in place.
+ * The buffer is reserved up front as a mapping which is only backed by
+ * memory as far as it is filled, so it never moves and every line stays
+ * valid until the reader is destroyed.
+ */
+struct reader {
+    char *buf;
+    size_t size;
+    size_t len;
+
+    /* Start of the line which is not yet complete */
+    size_t line;
+};
+
+void reader_init(struct reader *r);
+
+void reader_destroy(struct reader *r);
+
+ssize_t reader_read(struct reader *r,
+                    int fd,
+                    void (*func)(char *line, size_t len, void *arg),
+                    void *arg);
+
+#endif /* READER_H_ */
@@ -0,0 +1,469 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "proc-util.h"
+#include "store.h"
+#include "utf8.h"
+
+static void *store_copy(const void *mem, size_t size, size_t size_max)
+{
+    void *copy = malloc(size_max ? size_max : 1);
+
+    if (!copy)
+        die("Out of memory\n");
+
+    memcpy(copy, mem, size);
+
+    return copy;
+}
+
+/* Copy the names before the store adds one of its own */
+static void store_own_names(struct store *s)
+{
+    if (!s->shared_names)
+        return;
+
+    s->names = store_copy(s->names, s->size, s->size_max);
+    s->shared_names = false;
+}
+
+/* Copy the read-only layout before any item is modified */
+static void store_own_items(struct store *s)
+{
+    if (!s->shared_items)
+        return;
+
+    s->folds = store_copy(s->folds, s->size, s->size_max);
+    s->offsets = store_copy(s->offsets,
+                            s->n * sizeof(*s->offsets),
+                            s->n_max * sizeof(*s->offsets));
+    s->lens = store_copy(s->lens,
+                         s->n * sizeof(*s->lens),
+                         s->n_max * sizeof(*s->lens));
+
+    if (s->execs) {
+        s->execs = store_copy(s->execs,
+                              s->n * sizeof(*s->execs),
+                              s->n_max * sizeof(*s->execs));
+    }
+
+    s->shared_items = false;
+}
+
+static void store_grow_items(struct store *s, size_t n)
+{
+    if (s->n_max - s->n >= n)
+        return;
+
+    while (s->n_max - s->n < n)
+        s->n_max = (s->n_max) ? s->n_max * 2 : 1024;
+
+    s->offsets = realloc(s->offsets, s->n_max * sizeof(*s->offsets));
+    s->lens = realloc(s->lens, s->n_max * sizeof(*s->lens));
+    s->scores = realloc(s->scores, s->n_max * sizeof(*s->scores));
+    if (!s->offsets || !s->lens || !s->scores)
+        die("Out of memory\n");
+
+    if (s->execs) {
+        s->execs = realloc(s->execs, s->n_max * sizeof(*s->execs));
+        if (!s->execs)
+            die("Out of memory\n");
+    }
+}
+
+/* Names which are not owned are provided by the caller and never copied */
+static void store_grow_blobs(struct store *s, size_t size)
+{
+    if (s->size + size > UINT32_MAX)
+        die("Too many items\n");
+
+    if (s->size_max - s->size >= size)
+        return;
+
+    while (s->size_max - s->size < size)
+        s->size_max = (s->size_max) ? s->size_max * 2 : 64 * 1024;
+
+    s->folds = realloc(s->folds, s->size_max);
+    if (!s->folds)
+        die("Out of memory\n");
+
+    if (!s->shared_names) {
+        s->names = realloc(s->names, s->size_max);
+        if (!s->names)
+            die("Out of memory\n");
+    }
+}
+
+static void store_reserve(struct store *s, size_t n, size_t size)
+{
+    store_own_names(s);
+    store_own_items(s);
+    store_grow_items(s, n);
+    store_grow_blobs(s, size);
+}
+
+/* Move 'n' entries from 'src' to 'dst', the ranges may overlap */
+static void store_shift(struct store *s, size_t dst, size_t src, size_t n)
+{
+    memmove(s->offsets + dst, s->offsets + src, n * sizeof(*s->offsets));
+    memmove(s->lens + dst, s->lens + src, n * sizeof(*s->lens));
+    memmove(s->scores + dst, s->scores + src, n * sizeof(*s->scores));
+
+    if (s->execs)
+        memmove(s->execs + dst, s->execs + src, n * sizeof(*s->execs));
+}
+
+void store_init(struct store *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+/*
+ * Use the items laid out in read-only memory, e.g. in a mapped file, in
+ * place. Only the scores, which start at zero, are allocated.
+ */
+void store_init_view(struct store *s,
+                     const char *names,
+                     const char *folds,
+                     size_t size,
+                     const uint32_t *offsets,
+                     const uint32_t *lens,
+                     const uint32_t *execs,
+                     size_t n)
+{
+    store_init(s);
+
+    s->names = (char *) names;
+    s->folds = (char *) folds;
+    s->size = size;
+    s->size_max = size;
+    s->offsets = (uint32_t *) offsets;
+    s->lens = (uint32_t *) lens;
+    s->execs = (uint32_t *) execs;
+    s->n = n;
+    s->n_max = n;
+    s->shared_names = true;
+    s->shared_items = true;
+
+    s->scores = calloc(n ? n : 1, sizeof(*s->scores));
+    if (!s->scores)
+        die("Out of memory\n");
+}
+
+void store_destroy(struct store *s)
+{
+    if (!s->shared_names)
+        free(s->names);
+
+    if (!s->shared_items) {
+        free(s->folds);
+        free(s->offsets);
+        free(s->lens);
+        free(s->execs);
+    }
+
+    free(s->scores);
+}
+
+/*
+ * Let the empty store 's' take the names of its items from 'names', which
+ * belongs to the caller. It may only ever grow at its end without being
+ * moved, e.g. as the buffer of a reader.
+ */
+void store_share_names(struct store *s, const char *names)
+{
+    s->names = (char *) names;
+    s->shared_names = true;
+}
+
+/*
+ * Append the null-terminated 'name' of length 'len', which lies behind all
+ * other names in the names shared with the store. Only its folded copy is
+ * stored.
+ */
+void store_add_shared(struct store *s, const char *name, size_t len)
+{
+    size_t offset = (size_t) (name - s->names);
+
+    store_grow_items(s, 1);
+    store_grow_blobs(s, offset + len + 1 - s->size);
+
+    utf8_fold(s->folds + offset, name, len);
+    s->folds[offset + len] = '\0';
+
+    s->offsets[s->n] = (uint32_t) offset;
+    s->lens[s->n] = (uint32_t) len;
+    s->scores[s->n] = 0;
+
+    if (s->execs)
+        s->execs[s->n] = STORE_NONE;
+
+    s->size = offset + len + 1;
+    ++s->n;
+}
+
+void store_add(struct store *s, const char *name)
+{
+    size_t len = strlen(name);
+
+    store_reserve(s, 1, len + 1);
+
+    memcpy(s->names + s->size, name, len + 1);
+    utf8_fold(s->folds + s->size, name, len);
+    s->folds[s->size + len] = '\0';
+
+    s->offsets[s->n] = (uint32_t) s->size;
+    s->lens[s->n] = (uint32_t) len;
+    s->scores[s->n] = 0;
+
+    if (s->execs)
+        s->execs[s->n] = STORE_NONE;
+
+    s->size += len + 1;
+    ++s->n;
+}
+
+void store_insert(struct store *s, size_t i, const char *name)
+{
+    uint32_t offset, len;
+
+    store_add(s, name);
+
+    offset = s->offsets[s->n - 1];
+    len = s->lens[s->n - 1];
+
+    store_shift(s, i + 1, i, s->n - 1 - i);
+
+    s->offsets[i] = offset;
+    s->lens[i] = len;
+    s->scores[i] = 0;
+
+    if (s->execs)
+        s->execs[i] = STORE_NONE;
+}
+
+void store_remove(struct store *s, size_t i)
+{
+    store_own_items(s);
+
+    --s->n;
+
+    store_shift(s, i, i + 1, s->n - i);
+}
+
+/* Most items have no command line, so there is no array until one does */
+static void store_alloc_execs(struct store *s)
+{
+    s->execs = malloc(s->n_max * sizeof(*s->execs));
+    if (!s->execs)
+        die("Out of memory\n");
+
+    memset(s->execs, 0xff, s->n_max * sizeof(*s->execs));
+}
+
+/* Copy the command line 'exec' of the item 'i' into the names */
+void store_set_exec(struct store *s, size_t i, const char *exec)
+{
+    size_t len;
+
+    if (!exec) {
+        if (s->execs) {
+            store_own_items(s);
+            s->execs[i] = STORE_NONE;
+        }
+
+        return;
+    }
+
+    len = strlen(exec);
+
+    store_reserve(s, 0, len + 1);
+
+    if (!s->execs)
+        store_alloc_execs(s);
+
+    memcpy(s->names + s->size, exec, len + 1);
+
+    s->execs[i] = (uint32_t) s->size;
+    s->size += len + 1;
+}
+
+/* Move 'n' items of the index array 'order' along with all item arrays */
+static void store_permute(uint32_t *items,
+                          uint32_t *tmp,
+                          const uint32_t *order,
+                          size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        tmp[i] = items[order[i]];
+
+    memcpy(items, tmp, n * sizeof(*items));
+}
+
+/*
+ * Rearrange the items, so the item 'i' is the former item 'order[i]'.
+ * Only the 'n' items listed in 'order' are kept, their names stay where
+ * they are.
+ */
+void store_reorder(struct store *s, const uint32_t *order, size_t n)
+{
+    uint32_t *tmp = malloc((n ? n : 1) * sizeof(*tmp));
+
+    if (!tmp)
+        die("Out of memory\n");
+
+    store_own_items(s);
+
+    store_permute(s->offsets, tmp, order, n);
+    store_permute(s->lens, tmp, order, n);
+    store_permute(s->scores, tmp, order, n);
+
+    if (s->execs)
+        store_permute(s->execs, tmp, order, n);
+
+    s->n = n;
+
+    free(tmp);
+}
+
+/* Index of the first item of the sorted 's' which is not less than 'name' */
+size_t store_find(const struct store *s,
+                  const char *name,
+                  int (*compare)(const char *, const char *))
+{
+    size_t low = 0, high = s->n;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if (compare(store_name(s, mid), name) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/*
+ * Remove the items with the given 'names' from the sorted 's', if it holds
+ * them. Items with a command line are kept, they do not stand for a file
+ * of the same name. Returns the number of removed items.
+ */
+size_t store_drop(struct store *s,
+                  const char *const *names,
+                  size_t n,
+                  int (*compare)(const char *, const char *))
+{
+    size_t n_dropped = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t k = store_find(s, names[i], compare);
+
+        if (k >= s->n || store_exec(s, k))
+            continue;
+
+        if (strcmp(store_name(s, k), names[i]) == 0) {
+            store_remove(s, k);
+            ++n_dropped;
+        }
+    }
+
+    return n_dropped;
+}
+
+/*
+ * Merge the sorted items of 'src' into the sorted items of 's', skipping
+ * the ones which 's' already holds. The merge runs from the back to the
+ * front, so it can be done in place.
+ */
+void store_merge(struct store *s,
+                 const struct store *src,
+                 int (*compare)(const char *, const char *))
+{
+    size_t i = s->n, j = src->n, k;
+
+    if (!src->n)
+        return;
+
+    store_reserve(s, src->n, src->size);
+
+    if (src->execs && !s->execs)
+        store_alloc_execs(s);
+
+    k = s->n + src->n;
+
+    while (j > 0) {
+        size_t size;
+
+        if (i > 0) {
+            int diff = compare(store_name(s, i - 1), store_name(src, j - 1));
+
+            if (diff > 0) {
+                --i;
+                --k;
+                store_shift(s, k, i, 1);
+                continue;
+            }
+
+            /* Duplicates provided by another source */
+            if (diff == 0) {
+                --j;
+                continue;
+            }
+        }
+
+        --j;
+        --k;
+
+        size = (size_t) src->lens[j] + 1;
+        memcpy(s->names + s->size, store_name(src, j), size);
+        memcpy(s->folds + s->size, store_folded(src, j), size);
+
+        s->offsets[k] = (uint32_t) s->size;
+        s->lens[k] = src->lens[j];
+        s->scores[k] = src->scores[j];
+        s->size += size;
+
+        if (!s->execs)
+            continue;
+
+        s->execs[k] = STORE_NONE;
+
+        if (store_exec(src, j)) {
+            size = strlen(store_exec(src, j)) + 1;
+            memcpy(s->names + s->size, store_exec(src, j), size);
+
+            s->execs[k] = (uint32_t) s->size;
+            s->size += size;
+        }
+    }
+
+    /* Close the gap left by skipped duplicates */
+    store_shift(s, i, k, s->n + src->n - k);
+    s->n += src->n - (k - i);
+}
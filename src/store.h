@@ -0,0 +1,130 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef STORE_H_
+#define STORE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Marks an item without a command line */
+#define STORE_NONE UINT32_MAX
+
+/*
+ * The items of the menu, laid out for the matcher: All names live back to
+ * back in 'names' and their case-folded copies at the same offsets in
+ * 'folds', so scanning the items streams through memory and never folds a
+ * character. Scores and the offsets of command lines, which are kept in
+ * 'names' as well, have arrays of their own, the latter only once any item
+ * has a command line. The blobs only ever grow, removed items stay in them
+ * until the store is destroyed.
+ *
+ * A store may use memory it does not own: Its names may be provided by
+ * the caller, e.g. as the lines of the input, and the whole layout may be
+ * read-only, e.g. as part of a mapped file. Such memory has to outlive the
+ * store, which copies it before it is modified the first time.
+ */
+struct store {
+    char *names;
+    char *folds;
+    size_t size;
+    size_t size_max;
+
+    uint32_t *offsets;
+    uint32_t *lens;
+    uint32_t *scores;
+    uint32_t *execs;
+    size_t n;
+    size_t n_max;
+
+    /* The names, or everything except for the scores, are not owned */
+    bool shared_names;
+    bool shared_items;
+};
+
+void store_init(struct store *s);
+
+void store_init_view(struct store *s,
+                     const char *names,
+                     const char *folds,
+                     size_t size,
+                     const uint32_t *offsets,
+                     const uint32_t *lens,
+                     const uint32_t *execs,
+                     size_t n);
+
+void store_destroy(struct store *s);
+
+void store_share_names(struct store *s, const char *names);
+
+void store_add_shared(struct store *s, const char *name, size_t len);
+
+void store_add(struct store *s, const char *name);
+
+void store_insert(struct store *s, size_t i, const char *name);
+
+void store_remove(struct store *s, size_t i);
+
+void store_set_exec(struct store *s, size_t i, const char *exec);
+
+void store_reorder(struct store *s, const uint32_t *order, size_t n);
+
+size_t store_find(const struct store *s,
+                  const char *name,
+                  int (*compare)(const char *, const char *));
+
+size_t store_drop(struct store *s,
+                  const char *const *names,
+                  size_t n,
+                  int (*compare)(const char *, const char *));
+
+void store_merge(struct store *s,
+                 const struct store *src,
+                 int (*compare)(const char *, const char *));
+
+static inline const char *store_name(const struct store *s, size_t i)
+{
+    return s->names + s->offsets[i];
+}
+
+static inline const char *store_folded(const struct store *s, size_t i)
+{
+    return s->folds + s->offsets[i];
+}
+
+static inline size_t store_len(const struct store *s, size_t i)
+{
+    return s->lens[i];
+}
+
+static inline const char *store_exec(const struct store *s, size_t i)
+{
+    if (!s->execs || s->execs[i] == STORE_NONE)
+        return NULL;
+
+    return s->names + s->execs[i];
+}
+
+#endif /* STORE_H_ */
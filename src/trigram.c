@@ -0,0 +1,275 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "proc-util.h"
+
+#include "trigram.h"
+
+/* Upper limit of trigrams in a query which are looked up */
+#define TRIGRAM_MAX_LISTS 64
+
+static inline uint32_t trigram_key(const char *str)
+{
+    const unsigned char *s = (const unsigned char *) str;
+
+    return (uint32_t) s[0] | (uint32_t) s[1] << 8 | (uint32_t) s[2] << 16;
+}
+
+/*
+ * Sort the (trigram, item) pairs by their trigram. The radix sort is
+ * stable and the pairs are generated in the order of the items, so the
+ * items of every trigram end up sorted as well.
+ */
+static void trigram_sort(uint64_t *pairs, uint64_t *tmp, size_t n)
+{
+    for (int shift = 32; shift < 56; shift += 8) {
+        size_t count[256] = { 0 };
+        size_t sum = 0;
+
+        for (size_t i = 0; i < n; ++i)
+            ++count[(pairs[i] >> shift) & 0xff];
+
+        for (size_t i = 0; i < 256; ++i) {
+            size_t c = count[i];
+
+            count[i] = sum;
+            sum += c;
+        }
+
+        for (size_t i = 0; i < n; ++i)
+            tmp[count[(pairs[i] >> shift) & 0xff]++] = pairs[i];
+
+        memcpy(pairs, tmp, n * sizeof(*pairs));
+    }
+}
+
+/* Build the index of 'names', all memory is allocated from 'arena' */
+void trigram_build(struct trigram_index *t,
+                   const struct store *names,
+                   struct arena *arena)
+{
+    struct trigram *trigrams;
+    uint32_t *postings;
+    uint64_t *pairs, *tmp;
+    size_t n = names->n;
+    size_t n_pairs = 0, n_trigrams = 0, n_postings = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t len = store_len(names, i);
+
+        n_pairs += (len >= 3) ? len - 2 : 0;
+    }
+
+    pairs = malloc((n_pairs ? n_pairs : 1) * sizeof(*pairs));
+    tmp = malloc((n_pairs ? n_pairs : 1) * sizeof(*tmp));
+    if (!pairs || !tmp)
+        die("Out of memory\n");
+
+    n_pairs = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        const char *name = store_folded(names, i);
+
+        for (size_t j = 0; name[j] && name[j + 1] && name[j + 2]; ++j)
+            pairs[n_pairs++] = (uint64_t) trigram_key(name + j) << 32 | i;
+    }
+
+    trigram_sort(pairs, tmp, n_pairs);
+
+    /* An item containing the same trigram twice is only listed once */
+    for (size_t i = 0; i < n_pairs; ++i) {
+        if (i && pairs[i] == pairs[i - 1])
+            continue;
+
+        if (!i || pairs[i] >> 32 != pairs[i - 1] >> 32)
+            ++n_trigrams;
+
+        pairs[n_postings++] = pairs[i];
+    }
+
+    trigrams = arena_alloc(arena, (n_trigrams + 1) * sizeof(*trigrams));
+    postings = arena_alloc(arena, (n_postings + 1) * sizeof(*postings));
+
+    n_trigrams = 0;
+
+    for (size_t i = 0; i < n_postings; ++i) {
+        uint32_t key = (uint32_t) (pairs[i] >> 32);
+
+        if (!i || key != trigrams[n_trigrams - 1].key) {
+            trigrams[n_trigrams].key = key;
+            trigrams[n_trigrams].first = (uint32_t) i;
+            trigrams[n_trigrams].n = 0;
+            ++n_trigrams;
+        }
+
+        ++trigrams[n_trigrams - 1].n;
+        postings[i] = (uint32_t) pairs[i];
+    }
+
+    t->trigrams = trigrams;
+    t->n_trigrams = n_trigrams;
+    t->postings = postings;
+    t->n_postings = n_postings;
+    t->n_items = n;
+
+    free(tmp);
+    free(pairs);
+}
+
+static const struct trigram *
+trigram_find(const struct trigram_index *t, uint32_t key)
+{
+    size_t low = 0, high = t->n_trigrams;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if (t->trigrams[mid].key < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low < t->n_trigrams && t->trigrams[low].key == key)
+        return &t->trigrams[low];
+
+    return NULL;
+}
+
+/*
+ * Upper bound of the number of items containing the folded string 'str':
+ * The length of the shortest posting list of its trigrams.
+ */
+size_t trigram_estimate(const struct trigram_index *t, const char *str)
+{
+    size_t n = t->n_items;
+
+    for (size_t i = 0; str[i] && str[i + 1] && str[i + 2]; ++i) {
+        const struct trigram *tri = trigram_find(t, trigram_key(str + i));
+
+        if (!tri)
+            return 0;
+
+        if (tri->n < n)
+            n = tri->n;
+    }
+
+    return n;
+}
+
+struct trigram_list {
+    const uint32_t *begin;
+    const uint32_t *end;
+};
+
+/*
+ * Advance 'l' to the first entry not less than 'index': Galloping finds a
+ * range of the list which holds that entry, a binary search finds it in
+ * there. Both take logarithmic time in the distance to the entry.
+ */
+static const uint32_t *trigram_seek(struct trigram_list *l, uint32_t index)
+{
+    size_t step = 1;
+    const uint32_t *low = l->begin, *high;
+
+    while (low + step < l->end && low[step] < index) {
+        low += step;
+        step *= 2;
+    }
+
+    high = (low + step < l->end) ? low + step : l->end;
+
+    while (low < high) {
+        const uint32_t *mid = low + (high - low) / 2;
+
+        if (*mid < index)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    l->begin = low;
+
+    return low;
+}
+
+/*
+ * Call 'func' for every item which contains all trigrams of the folded
+ * string 'str', in ascending order. The shortest posting list drives the
+ * intersection, the others are only searched.
+ */
+void trigram_intersect(const struct trigram_index *t,
+                       const char *str,
+                       void (*func)(uint32_t index, void *arg),
+                       void *arg)
+{
+    struct trigram_list lists[TRIGRAM_MAX_LISTS];
+    size_t n = 0;
+
+    for (size_t i = 0; str[i] && str[i + 1] && str[i + 2]; ++i) {
+        const struct trigram *tri = trigram_find(t, trigram_key(str + i));
+        struct trigram_list l;
+        size_t j;
+
+        if (!tri)
+            return;
+
+        if (n == TRIGRAM_MAX_LISTS)
+            break;
+
+        l.begin = t->postings + tri->first;
+        l.end = l.begin + tri->n;
+
+        /* Keep the lists sorted by length */
+        for (j = n; j > 0 && lists[j - 1].end - lists[j - 1].begin
+                                 > l.end - l.begin; --j)
+            lists[j] = lists[j - 1];
+
+        lists[j] = l;
+        ++n;
+    }
+
+    if (!n)
+        return;
+
+    for (const uint32_t *p = lists[0].begin; p < lists[0].end; ++p) {
+        bool found = true;
+
+        for (size_t i = 1; i < n && found; ++i) {
+            const uint32_t *q = trigram_seek(&lists[i], *p);
+
+            if (q == lists[i].end)
+                return;
+
+            found = (*q == *p);
+        }
+
+        if (found)
+            func(*p, arg);
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TRIGRAM_H_
+#define TRIGRAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "store.h"
+
+/*
+ * Inverted index of the trigrams (three consecutive, case-folded bytes)
+ * in the names of an item list: Every trigram refers to the sorted range
+ * of 'postings' which holds the indices of all items containing it.
+ */
+struct trigram {
+    uint32_t key;
+    uint32_t first;
+    uint32_t n;
+};
+
+struct trigram_index {
+    const struct trigram *trigrams;
+    size_t n_trigrams;
+
+    const uint32_t *postings;
+    size_t n_postings;
+
+    /* Number of items in the indexed list */
+    size_t n_items;
+};
+
+void trigram_build(struct trigram_index *t,
+                   const struct store *names,
+                   struct arena *arena);
+
+size_t trigram_estimate(const struct trigram_index *t, const char *str);
+
+void trigram_intersect(const struct trigram_index *t,
+                       const char *str,
+                       void (*func)(uint32_t index, void *arg),
+                       void *arg);
+
+#endif /* TRIGRAM_H_ */
@@ -0,0 +1,404 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "utf8.h"
+
+#define ARRAY_SIZE(x) (sizeof((x)) / sizeof(*(x)))
+
+/*
+ * Upper case letters outside of ASCII and the distance to their lower case
+ * counterparts, taken from the simple case folding of Unicode 14.0. In
+ * ranges with a stride of 2, upper and lower case letters alternate and
+ * only the code points at an even distance to 'first' fold.
+ */
+struct utf8_fold_range {
+    uint32_t first;
+    uint32_t last;
+    int32_t delta;
+    uint32_t stride;
+};
+
+/* clang-format off */
+static const struct utf8_fold_range utf8_fold_ranges[] = {
+    { 0x00b5, 0x00b5,    775, 1 },
+    { 0x00c0, 0x00d6,     32, 1 },
+    { 0x00d8, 0x00de,     32, 1 },
+    { 0x0100, 0x012e,      1, 2 },
+    { 0x0132, 0x0136,      1, 2 },
+    { 0x0139, 0x0147,      1, 2 },
+    { 0x014a, 0x0176,      1, 2 },
+    { 0x0178, 0x0178,   -121, 1 },
+    { 0x0179, 0x017d,      1, 2 },
+    { 0x0181, 0x0181,    210, 1 },
+    { 0x0182, 0x0184,      1, 2 },
+    { 0x0186, 0x0186,    206, 1 },
+    { 0x0187, 0x0187,      1, 1 },
+    { 0x0189, 0x018a,    205, 1 },
+    { 0x018b, 0x018b,      1, 1 },
+    { 0x018e, 0x018e,     79, 1 },
+    { 0x018f, 0x018f,    202, 1 },
+    { 0x0190, 0x0190,    203, 1 },
+    { 0x0191, 0x0191,      1, 1 },
+    { 0x0193, 0x0193,    205, 1 },
+    { 0x0194, 0x0194,    207, 1 },
+    { 0x0196, 0x0196,    211, 1 },
+    { 0x0197, 0x0197,    209, 1 },
+    { 0x0198, 0x0198,      1, 1 },
+    { 0x019c, 0x019c,    211, 1 },
+    { 0x019d, 0x019d,    213, 1 },
+    { 0x019f, 0x019f,    214, 1 },
+    { 0x01a0, 0x01a4,      1, 2 },
+    { 0x01a6, 0x01a6,    218, 1 },
+    { 0x01a7, 0x01a7,      1, 1 },
+    { 0x01a9, 0x01a9,    218, 1 },
+    { 0x01ac, 0x01ac,      1, 1 },
+    { 0x01ae, 0x01ae,    218, 1 },
+    { 0x01af, 0x01af,      1, 1 },
+    { 0x01b1, 0x01b2,    217, 1 },
+    { 0x01b3, 0x01b5,      1, 2 },
+    { 0x01b7, 0x01b7,    219, 1 },
+    { 0x01b8, 0x01b8,      1, 1 },
+    { 0x01bc, 0x01bc,      1, 1 },
+    { 0x01c4, 0x01c4,      2, 1 },
+    { 0x01c5, 0x01c5,      1, 1 },
+    { 0x01c7, 0x01c7,      2, 1 },
+    { 0x01c8, 0x01c8,      1, 1 },
+    { 0x01ca, 0x01ca,      2, 1 },
+    { 0x01cb, 0x01db,      1, 2 },
+    { 0x01de, 0x01ee,      1, 2 },
+    { 0x01f1, 0x01f1,      2, 1 },
+    { 0x01f2, 0x01f4,      1, 2 },
+    { 0x01f6, 0x01f6,    -97, 1 },
+    { 0x01f7, 0x01f7,    -56, 1 },
+    { 0x01f8, 0x021e,      1, 2 },
+    { 0x0220, 0x0220,   -130, 1 },
+    { 0x0222, 0x0232,      1, 2 },
+    { 0x023b, 0x023b,      1, 1 },
+    { 0x023d, 0x023d,   -163, 1 },
+    { 0x0241, 0x0241,      1, 1 },
+    { 0x0243, 0x0243,   -195, 1 },
+    { 0x0244, 0x0244,     69, 1 },
+    { 0x0245, 0x0245,     71, 1 },
+    { 0x0246, 0x024e,      1, 2 },
+    { 0x0345, 0x0345,    116, 1 },
+    { 0x0370, 0x0372,      1, 2 },
+    { 0x0376, 0x0376,      1, 1 },
+    { 0x037f, 0x037f,    116, 1 },
+    { 0x0386, 0x0386,     38, 1 },
+    { 0x0388, 0x038a,     37, 1 },
+    { 0x038c, 0x038c,     64, 1 },
+    { 0x038e, 0x038f,     63, 1 },
+    { 0x0391, 0x03a1,     32, 1 },
+    { 0x03a3, 0x03ab,     32, 1 },
+    { 0x03c2, 0x03c2,      1, 1 },
+    { 0x03cf, 0x03cf,      8, 1 },
+    { 0x03d0, 0x03d0,    -30, 1 },
+    { 0x03d1, 0x03d1,    -25, 1 },
+    { 0x03d5, 0x03d5,    -15, 1 },
+    { 0x03d6, 0x03d6,    -22, 1 },
+    { 0x03d8, 0x03ee,      1, 2 },
+    { 0x03f0, 0x03f0,    -54, 1 },
+    { 0x03f1, 0x03f1,    -48, 1 },
+    { 0x03f4, 0x03f4,    -60, 1 },
+    { 0x03f5, 0x03f5,    -64, 1 },
+    { 0x03f7, 0x03f7,      1, 1 },
+    { 0x03f9, 0x03f9,     -7, 1 },
+    { 0x03fa, 0x03fa,      1, 1 },
+    { 0x03fd, 0x03ff,   -130, 1 },
+    { 0x0400, 0x040f,     80, 1 },
+    { 0x0410, 0x042f,     32, 1 },
+    { 0x0460, 0x0480,      1, 2 },
+    { 0x048a, 0x04be,      1, 2 },
+    { 0x04c0, 0x04c0,     15, 1 },
+    { 0x04c1, 0x04cd,      1, 2 },
+    { 0x04d0, 0x052e,      1, 2 },
+    { 0x0531, 0x0556,     48, 1 },
+    { 0x10a0, 0x10c5,   7264, 1 },
+    { 0x10c7, 0x10c7,   7264, 1 },
+    { 0x10cd, 0x10cd,   7264, 1 },
+    { 0x13f8, 0x13fd,     -8, 1 },
+    { 0x1c88, 0x1c88,  35267, 1 },
+    { 0x1c90, 0x1cba,  -3008, 1 },
+    { 0x1cbd, 0x1cbf,  -3008, 1 },
+    { 0x1e00, 0x1e94,      1, 2 },
+    { 0x1e9b, 0x1e9b,    -58, 1 },
+    { 0x1ea0, 0x1efe,      1, 2 },
+    { 0x1f08, 0x1f0f,     -8, 1 },
+    { 0x1f18, 0x1f1d,     -8, 1 },
+    { 0x1f28, 0x1f2f,     -8, 1 },
+    { 0x1f38, 0x1f3f,     -8, 1 },
+    { 0x1f48, 0x1f4d,     -8, 1 },
+    { 0x1f59, 0x1f5f,     -8, 2 },
+    { 0x1f68, 0x1f6f,     -8, 1 },
+    { 0x1f88, 0x1f8f,     -8, 1 },
+    { 0x1f98, 0x1f9f,     -8, 1 },
+    { 0x1fa8, 0x1faf,     -8, 1 },
+    { 0x1fb8, 0x1fb9,     -8, 1 },
+    { 0x1fba, 0x1fbb,    -74, 1 },
+    { 0x1fbc, 0x1fbc,     -9, 1 },
+    { 0x1fc8, 0x1fcb,    -86, 1 },
+    { 0x1fcc, 0x1fcc,     -9, 1 },
+    { 0x1fd8, 0x1fd9,     -8, 1 },
+    { 0x1fda, 0x1fdb,   -100, 1 },
+    { 0x1fe8, 0x1fe9,     -8, 1 },
+    { 0x1fea, 0x1feb,   -112, 1 },
+    { 0x1fec, 0x1fec,     -7, 1 },
+    { 0x1ff8, 0x1ff9,   -128, 1 },
+    { 0x1ffa, 0x1ffb,   -126, 1 },
+    { 0x1ffc, 0x1ffc,     -9, 1 },
+    { 0x2132, 0x2132,     28, 1 },
+    { 0x2160, 0x216f,     16, 1 },
+    { 0x2183, 0x2183,      1, 1 },
+    { 0x24b6, 0x24cf,     26, 1 },
+    { 0x2c00, 0x2c2f,     48, 1 },
+    { 0x2c60, 0x2c60,      1, 1 },
+    { 0x2c63, 0x2c63,  -3814, 1 },
+    { 0x2c67, 0x2c6b,      1, 2 },
+    { 0x2c72, 0x2c72,      1, 1 },
+    { 0x2c75, 0x2c75,      1, 1 },
+    { 0x2c80, 0x2ce2,      1, 2 },
+    { 0x2ceb, 0x2ced,      1, 2 },
+    { 0x2cf2, 0x2cf2,      1, 1 },
+    { 0xa640, 0xa66c,      1, 2 },
+    { 0xa680, 0xa69a,      1, 2 },
+    { 0xa722, 0xa72e,      1, 2 },
+    { 0xa732, 0xa76e,      1, 2 },
+    { 0xa779, 0xa77b,      1, 2 },
+    { 0xa77d, 0xa77d, -35332, 1 },
+    { 0xa77e, 0xa786,      1, 2 },
+    { 0xa78b, 0xa78b,      1, 1 },
+    { 0xa790, 0xa792,      1, 2 },
+    { 0xa796, 0xa7a8,      1, 2 },
+    { 0xa7b3, 0xa7b3,    928, 1 },
+    { 0xa7b4, 0xa7c2,      1, 2 },
+    { 0xa7c4, 0xa7c4,    -48, 1 },
+    { 0xa7c6, 0xa7c6, -35384, 1 },
+    { 0xa7c7, 0xa7c9,      1, 2 },
+    { 0xa7d0, 0xa7d0,      1, 1 },
+    { 0xa7d6, 0xa7d8,      1, 2 },
+    { 0xa7f5, 0xa7f5,      1, 1 },
+    { 0xab70, 0xabbf, -38864, 1 },
+    { 0xff21, 0xff3a,     32, 1 },
+    { 0x010400, 0x010427,     40, 1 },
+    { 0x0104b0, 0x0104d3,     40, 1 },
+    { 0x010570, 0x01057a,     39, 1 },
+    { 0x01057c, 0x01058a,     39, 1 },
+    { 0x01058c, 0x010592,     39, 1 },
+    { 0x010594, 0x010595,     39, 1 },
+    { 0x010c80, 0x010cb2,     64, 1 },
+    { 0x0118a0, 0x0118bf,     32, 1 },
+    { 0x016e40, 0x016e5f,     32, 1 },
+    { 0x01e900, 0x01e921,     34, 1 },
+};
+/* clang-format on */
+
+static uint32_t utf8_fold_char(uint32_t c)
+{
+    size_t low = 0, high = ARRAY_SIZE(utf8_fold_ranges);
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const struct utf8_fold_range *r = &utf8_fold_ranges[mid];
+
+        if (c < r->first) {
+            high = mid;
+        } else if (c > r->last) {
+            low = mid + 1;
+        } else {
+            if ((c - r->first) % r->stride)
+                return c;
+
+            return (uint32_t) ((int32_t) c + r->delta);
+        }
+    }
+
+    return c;
+}
+
+/* Length of the sequence starting with 'c', 0 if it cannot start one */
+static size_t utf8_seq_len(unsigned char c)
+{
+    if (c < 0x80)
+        return 1;
+
+    if (c >= 0xc2 && c <= 0xdf)
+        return 2;
+
+    if ((c & 0xf0) == 0xe0)
+        return 3;
+
+    if (c >= 0xf0 && c <= 0xf4)
+        return 4;
+
+    return 0;
+}
+
+size_t utf8_decode(const char *str, size_t len, uint32_t *c)
+{
+    const unsigned char *s = (const unsigned char *) str;
+    size_t n = utf8_seq_len(s[0]);
+
+    if (!n || n > len)
+        return 0;
+
+    *c = (n == 1) ? s[0] : s[0] & (0x7f >> n);
+
+    for (size_t i = 1; i < n; ++i) {
+        if ((s[i] & 0xc0) != 0x80)
+            return 0;
+
+        *c = *c << 6 | (s[i] & 0x3f);
+    }
+
+    return n;
+}
+
+/* Encode 'c' into the 'n' bytes it was decoded from */
+static void utf8_encode(char *str, size_t n, uint32_t c)
+{
+    static const unsigned char lead[] = { 0, 0, 0xc0, 0xe0, 0xf0 };
+
+    for (size_t i = n - 1; i > 0; --i) {
+        str[i] = (char) (0x80 | (c & 0x3f));
+        c >>= 6;
+    }
+
+    str[0] = (char) (lead[n] | c);
+}
+
+/* Fold 'len' bytes of 'src' into 'dst', which may be the same string */
+void utf8_fold(char *dst, const char *src, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len) {
+        unsigned char c = (unsigned char) src[i];
+        uint32_t code;
+        size_t n;
+
+        /* Plain ASCII takes the fast path */
+        if (c < 0x80) {
+            dst[i++] = (char) ((c >= 'A' && c <= 'Z') ? c | 0x20 : c);
+            continue;
+        }
+
+        n = utf8_decode(src + i, len - i, &code);
+        if (!n) {
+            dst[i++] = (char) c;
+            continue;
+        }
+
+        utf8_encode(dst + i, n, utf8_fold_char(code));
+        i += n;
+    }
+}
+
+size_t utf8_last_len(const char *str, size_t len)
+{
+    size_t n = 1;
+
+    while (n < len && n < 4 && (str[len - n] & 0xc0) == 0x80)
+        ++n;
+
+    return n;
+}
+
+size_t utf8_complete_len(const char *str, size_t len)
+{
+    size_t n;
+
+    if (!len)
+        return 0;
+
+    n = utf8_last_len(str, len);
+    if (utf8_seq_len((unsigned char) str[len - n]) > n)
+        return len - n;
+
+    return len;
+}
+
+/*
+ * Length of the valid sequence at the start of 'str', 0 if it is invalid.
+ * Unlike utf8_decode(), this also rejects overlong encodings, surrogates
+ * and code points beyond U+10FFFF, just as any renderer would.
+ */
+static size_t utf8_valid_len(const char *str, size_t len)
+{
+    static const uint32_t min[] = { 0, 0, 0x80, 0x800, 0x10000 };
+    uint32_t c;
+    size_t n = utf8_decode(str, len, &c);
+
+    if (n < 2)
+        return n;
+
+    if (c < min[n] || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+        return 0;
+
+    return n;
+}
+
+bool utf8_is_valid(const char *str, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len) {
+        size_t n = ((unsigned char) str[i] < 0x80)
+                       ? 1
+                       : utf8_valid_len(str + i, len - i);
+
+        if (!n)
+            return false;
+
+        i += n;
+    }
+
+    return true;
+}
+
+size_t utf8_sanitize(char *dst, const char *src, size_t len)
+{
+    size_t i = 0, j = 0;
+
+    while (i < len) {
+        size_t n = ((unsigned char) src[i] < 0x80)
+                       ? 1
+                       : utf8_valid_len(src + i, len - i);
+
+        if (!n) {
+            memcpy(dst + j, UTF8_REPLACEMENT, sizeof(UTF8_REPLACEMENT) - 1);
+            j += sizeof(UTF8_REPLACEMENT) - 1;
+            ++i;
+            continue;
+        }
+
+        memcpy(dst + j, src + i, n);
+        i += n;
+        j += n;
+    }
+
+    return j;
+}
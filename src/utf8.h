@@ -0,0 +1,68 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UTF8_H_
+#define UTF8_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* U+FFFD, which stands in for invalid sequences */
+#define UTF8_REPLACEMENT "\xef\xbf\xbd"
+
+/*
+ * Simple Unicode case folding of UTF-8 strings. Only mappings which keep
+ * the length of the encoded character are applied, so a folded string is
+ * exactly as long as the original one and the bytes of both line up.
+ * Invalid sequences are copied unchanged.
+ */
+void utf8_fold(char *dst, const char *src, size_t len);
+
+/*
+ * Decode the character at the start of 'str', which is 'len' bytes long,
+ * into 'c'. Returns the length of its sequence or 0 if it is invalid.
+ */
+size_t utf8_decode(const char *str, size_t len, uint32_t *c);
+
+/* Number of bytes of the last character of 'str', which is 'len' long */
+size_t utf8_last_len(const char *str, size_t len);
+
+/*
+ * Length of 'str' without a sequence at its end which is cut off, as at
+ * the end of a prefix of a longer string.
+ */
+size_t utf8_complete_len(const char *str, size_t len);
+
+/* Check that the 'len' bytes of 'str' are well-formed UTF-8 */
+bool utf8_is_valid(const char *str, size_t len);
+
+/*
+ * Copy 'len' bytes of 'src' to 'dst' and replace every byte which does not
+ * belong to a valid sequence with U+FFFD. 'dst' needs room for three times
+ * 'len' bytes. Returns the length of the copy.
+ */
+size_t utf8_sanitize(char *dst, const char *src, size_t len);
+
+#endif /* UTF8_H_ */
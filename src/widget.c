@@ -22,6 +22,7 @@
  * SOFTWARE.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -30,8 +31,7 @@
 
 #include "widget.h"
 #include "proc-util.h"
-
-#define ARRAY_SIZE(x) (sizeof((x)) / sizeof(*(x)))
+#include "utf8.h"
 
 #define GLYPH_BUFFER_SIZE 64
 
@@ -52,7 +52,6 @@ static void cairo_util_show_glyphs(cairo_t *cairo,
 {
     int n = n_glyphs - max_glyphs;
     if (n > 0) {
-        printf("luled %d, %d, %d\n", n_glyphs, max_glyphs, n);
         int32_t offset = glyphs[n].x - glyphs[0].x;
 
         glyphs += n;
@@ -114,6 +113,20 @@ static void widget_show_text(struct widget *w,
     if (!len)
         return;
 
+    /* Rows may come from any input, but cairo only accepts valid UTF-8 */
+    if (!utf8_is_valid(str, len)) {
+        if (w->text_size < 3 * len) {
+            w->text_size = 3 * len;
+
+            w->text = realloc(w->text, w->text_size);
+            if (!w->text)
+                die("Out of memory\n");
+        }
+
+        len = utf8_sanitize(w->text, str, len);
+        str = w->text;
+    }
+
     x += w->glyph_offset_x;
     y += w->glyph_offset_y;
 
@@ -197,6 +210,22 @@ static void widget_draw_output(struct widget *w)
     cairo_stroke(w->cr);
 }
 
+/* Show the number of matches right-aligned in the input field */
+static void widget_draw_matches(struct widget *w)
+{
+    int32_t x = w->input.x + w->input.width;
+    int32_t y = w->input.y + w->input.height / 2;
+    char buf[32];
+    int len;
+
+    len = snprintf(buf, sizeof(buf), "%zu", w->n_matches);
+
+    x -= (len + 2) * w->max_glyph_width;
+    if (x < w->input.x)
+        return;
+
+    widget_show_text(w, x, y, buf, (size_t) len, len);
+}
 
 static void widget_draw_input(struct widget *w)
 {
@@ -212,6 +241,8 @@ static void widget_draw_input(struct widget *w)
     cairo_stroke(w->cr);
     
     widget_show_text(w, x, y, w->str, w->len, w->max_glyphs_input);
+
+    widget_draw_matches(w);
 }
 
 void widget_init(struct widget *w)
@@ -229,6 +260,12 @@ void widget_init(struct widget *w)
         die("Out of memory\n");
 
     w->max_rows = 10;
+
+    w->str = calloc(32, sizeof(*w->str));
+    if (!w->str)
+        die("Out of memory\n");
+
+    w->size = 32;
         
     w->glyphs = malloc(GLYPH_BUFFER_SIZE * sizeof(*w->glyphs));
     if (!w->glyphs)
@@ -247,7 +284,9 @@ void widget_destroy(struct widget *w)
         FT_Done_Face(w->face);
 
     free(w->glyphs);
+    free(w->text);
     free(w->rows);
+    free(w->str);
 
     FT_Done_Library(w->freetype);
 }
@@ -278,6 +317,11 @@ void widget_set_max_rows(struct widget *w, size_t max_rows)
     w->max_rows = max_rows;
 }
 
+size_t widget_max_rows(const struct widget *w)
+{
+    return w->max_rows;
+}
+
 void widget_configure(struct widget *w,
                       void *mem,
                       int32_t width,
@@ -353,16 +397,34 @@ size_t widget_input_strlen(const struct widget *w)
     return w->len;
 }
 
-void widget_insert_char(struct widget *w, int c)
+/* Append the UTF-8 encoded 'str', control characters are ignored */
+void widget_insert_str(struct widget *w, const char *str)
 {
-    if (w->len < ARRAY_SIZE(w->str) - 1 && isascii(c))
-        w->str[w->len++] = c;
+    size_t len = strlen(str);
+
+    if (!len || iscntrl((unsigned char) str[0]))
+        return;
+
+    if (w->len + len + 1 > w->size) {
+        while (w->len + len + 1 > w->size)
+            w->size *= 2;
+
+        w->str = realloc(w->str, w->size);
+        if (!w->str)
+            die("Out of memory\n");
+    }
+
+    memcpy(w->str + w->len, str, len + 1);
+    w->len += len;
 }
 
+/* Remove the last character, which may span multiple bytes */
 void widget_remove_char(struct widget *w)
 {
-    if (w->len)
-        w->str[--w->len] = '\0';
+    if (w->len) {
+        w->len -= utf8_last_len(w->str, w->len);
+        w->str[w->len] = '\0';
+    }
 }
 
 const char *widget_highlight(const struct widget *w)
@@ -388,6 +450,11 @@ void widget_insert_row(struct widget *w, char *str)
         w->rows[w->n_rows++] = str;
 }
 
+void widget_set_matches(struct widget *w, size_t n)
+{
+    w->n_matches = n;
+}
+
 bool widget_has_empty_row(const struct widget *w)
 {
     return w->n_rows < w->max_rows;
@@ -58,11 +58,20 @@ struct widget {
     size_t max_rows;
     size_t highlight;
 
-    char str[32];
+    /* UTF-8 encoded input */
+    char *str;
     size_t len;
+    size_t size;
+
+    /* Number of items matching the input */
+    size_t n_matches;
 
     cairo_glyph_t *glyphs;
     int n_glyphs;
+
+    /* Copy of a text with its invalid UTF-8 sequences replaced */
+    char *text;
+    size_t text_size;
     int max_glyphs_output;
     int max_glyphs_input;
 
@@ -91,6 +100,8 @@ void widget_set_font_size(struct widget *w, double size);
 
 void widget_set_max_rows(struct widget *w, size_t max_rows);
 
+size_t widget_max_rows(const struct widget *w);
+
 void widget_configure(struct widget *w,
                       void *mem,
                       int32_t width,
@@ -103,7 +114,7 @@ const char *widget_input_str(const struct widget *w);
 
 size_t widget_input_strlen(const struct widget *w);
 
-void widget_insert_char(struct widget *w, int c);
+void widget_insert_str(struct widget *w, const char *str);
 
 void widget_remove_char(struct widget *w);
 
@@ -115,6 +126,8 @@ void widget_highlight_down(struct widget *w);
 
 void widget_insert_row(struct widget *w, char *str);
 
+void widget_set_matches(struct widget *w, size_t n);
+
 bool widget_has_empty_row(const struct widget *w);
 
 void widget_clear_rows(struct widget *w);
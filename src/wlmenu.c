@@ -23,9 +23,14 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <linux/memfd.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 #include <sys/mman.h>
 #include <sys/timerfd.h>
 #include <time.h>
@@ -34,10 +39,31 @@
 
 #include "wlmenu.h"
 
+#include "desktop.h"
 #include "proc-util.h"
+#include "utf8.h"
 
 #define ARRAY_SIZE(x) (sizeof((x)) / sizeof(*(x)))
 
+/* An input starting with this is a regular expression */
+#define WLMENU_REGEX_PREFIX '/'
+
+/* Number of candidates searched by one task of the worker pool */
+#define WLMENU_CHUNK_SIZE (16 * 1024)
+
+/* Items read while all rows are taken are searched at most this often */
+#define WLMENU_INPUT_INTERVAL_NS (50 * 1000 * 1000)
+
+/* Inputs with longer names in total are not indexed */
+#define WLMENU_INDEX_MAX_SIZE (16 * 1024 * 1024)
+
+/*
+ * Number of event sources of the main loop: The display, key repeat, the
+ * search results, the loader, the watched directories, the input and its
+ * timer. All of them can be drained by a single epoll_wait().
+ */
+#define WLMENU_MAX_EVENTS 7
+
 static void wlmenu_draw(struct wlmenu *w)
 {
     struct rectangle a;
@@ -254,61 +280,1275 @@ static void output_done(void *data, struct wl_output *output)
     (void) output;
 }
 
-static void output_scale(void *data, struct wl_output *output, int32_t factor)
+static void output_scale(void *data, struct wl_output *output, int32_t factor)
+{
+    struct wlmenu *w = data;
+
+    (void) w;
+    (void) output;
+    (void) factor;
+}
+
+const struct wl_output_listener output_listener = {
+    .geometry = &output_geometry,
+    .mode = &output_mode,
+    .done = &output_done,
+    .scale = &output_scale,
+};
+
+struct wlmenu_match {
+    uint64_t key;
+    size_t index;
+};
+
+/* Higher keys come first, matches with the same key keep the list order */
+static bool wlmenu_match_before(const struct wlmenu_match *a,
+                                const struct wlmenu_match *b)
+{
+    if (a->key != b->key)
+        return a->key > b->key;
+
+    return a->index < b->index;
+}
+
+static int wlmenu_match_compare(const void *a, const void *b)
+{
+    return wlmenu_match_before(a, b) ? -1 : 1;
+}
+
+/*
+ * Offer the item 'index' to the 'max' best matches so far. They are kept
+ * in a heap with the worst of them at the root, so every rejected item is
+ * turned down by a single comparison.
+ */
+static void wlmenu_rank_item(struct wlmenu_match *top,
+                             size_t *n,
+                             size_t max,
+                             size_t index,
+                             uint64_t key)
+{
+    struct wlmenu_match m = { key, index };
+    size_t i;
+
+    if (!max)
+        return;
+
+    if (*n < max) {
+        i = (*n)++;
+
+        while (i > 0 && wlmenu_match_before(&top[(i - 1) / 2], &m)) {
+            top[i] = top[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+
+        top[i] = m;
+        return;
+    }
+
+    if (!wlmenu_match_before(&m, &top[0]))
+        return;
+
+    i = 0;
+
+    while (2 * i + 1 < max) {
+        size_t child = 2 * i + 1;
+
+        if (child + 1 < max
+            && wlmenu_match_before(&top[child], &top[child + 1]))
+            ++child;
+
+        if (!wlmenu_match_before(&m, &top[child]))
+            break;
+
+        top[i] = top[child];
+        i = child;
+    }
+
+    top[i] = m;
+}
+
+/* Bring the heap of the best matches into their final order */
+static void wlmenu_sort_matches(struct wlmenu_match *top, size_t n)
+{
+    qsort(top, n, sizeof(*top), &wlmenu_match_compare);
+}
+
+/*
+ * Substring matches are ranked by where the matches of the terms start
+ * ('class' is the sum of their classes), by the launch history and by the
+ * length of the name, shorter names first.
+ */
+static uint64_t wlmenu_substring_key(unsigned int class,
+                                     const struct store *store,
+                                     size_t i)
+{
+    size_t len = store_len(store, i);
+
+    if (len > UINT16_MAX)
+        len = UINT16_MAX;
+
+    return (uint64_t) class << 48 | (uint64_t) store->scores[i] << 16
+           | (UINT16_MAX - len);
+}
+
+/*
+ * Fuzzy matches are ranked by the quality of the matches of all terms
+ * first and by the launch history second.
+ */
+static uint64_t wlmenu_rank_key(const struct match_query *const *queries,
+                                size_t n,
+                                const struct store *store,
+                                size_t k)
+{
+    const char *name = store_name(store, k);
+    const char *folded = store_folded(store, k);
+    unsigned int class = 0;
+    int32_t sum = 0;
+    uint64_t score;
+
+    if (queries[0]->mode != MATCH_FUZZY) {
+        for (size_t i = 0; i < n; ++i)
+            class += match_query_class(queries[i], name, folded);
+
+        return wlmenu_substring_key(class, store, k);
+    }
+
+    for (size_t i = 0; i < n; ++i)
+        sum += match_query_score(queries[i], name, folded);
+
+    /* Flipping the sign bit keeps the order of the signed scores */
+    score = (uint32_t) sum ^ UINT32_C(0x80000000);
+
+    return score << 32 | store->scores[k];
+}
+
+/*
+ * Long lists of candidates are split into chunks which are searched by
+ * the worker pool. Every chunk keeps its own results, so the workers never
+ * have to synchronize and the results can be combined in order afterwards.
+ */
+struct wlmenu_job {
+    const struct wlmenu *w;
+    unsigned long generation;
+
+    /* Candidates of the job, all items if there is no such level */
+    const struct match_level *src;
+    size_t n;
+
+    /* Terms the candidates of a ranking job are ranked by */
+    const struct match_query *const *queries;
+    size_t n_queries;
+
+    /* Level receiving the matches of a filter job */
+    struct match_level *dst;
+    size_t *counts;
+
+    /* The best matches of every chunk of a ranking job */
+    struct wlmenu_match *top;
+    size_t *n_top;
+    size_t max;
+
+    /* If set, only matches ranked below this key are taken */
+    uint64_t key_limit;
+};
+
+/* A newer search makes the results of the job useless */
+static bool wlmenu_job_cancelled(const struct wlmenu_job *job)
+{
+    return atomic_load(&job->w->search.generation) != job->generation;
+}
+
+static size_t wlmenu_job_item(const struct wlmenu_job *job, size_t i)
+{
+    return (job->src) ? job->src->index[i] : i;
+}
+
+static void wlmenu_job_range(const struct wlmenu_job *job,
+                             size_t i,
+                             size_t *begin,
+                             size_t *end)
+{
+    *begin = i * WLMENU_CHUNK_SIZE;
+    *end = *begin + WLMENU_CHUNK_SIZE;
+
+    if (*end > job->n)
+        *end = job->n;
+}
+
+/* The matches of a chunk are stored at the start of its range in 'dst' */
+static void wlmenu_filter_chunk(void *arg, size_t i)
+{
+    struct wlmenu_job *job = arg;
+    const struct match_query *q = &job->dst->query;
+    const struct store *store = &job->w->store;
+    size_t begin, end, n = 0;
+    size_t *out;
+
+    wlmenu_job_range(job, i, &begin, &end);
+    out = job->dst->index + begin;
+
+    if (wlmenu_job_cancelled(job))
+        end = begin;
+
+    for (size_t j = begin; j < end; ++j) {
+        size_t k = wlmenu_job_item(job, j);
+
+        if (store_len(store, k) < q->min_len)
+            continue;
+
+        if (match_query_find(q, store_folded(store, k)))
+            out[n++] = k;
+    }
+
+    job->counts[i] = n;
+}
+
+static void wlmenu_rank_chunk(void *arg, size_t i)
+{
+    struct wlmenu_job *job = arg;
+    struct wlmenu_match *top = job->top + i * job->max;
+    const struct store *store = &job->w->store;
+    size_t begin, end;
+
+    wlmenu_job_range(job, i, &begin, &end);
+
+    job->n_top[i] = 0;
+
+    if (wlmenu_job_cancelled(job))
+        return;
+
+    for (size_t j = begin; j < end; ++j) {
+        size_t k = wlmenu_job_item(job, j);
+        uint64_t key = store->scores[k];
+
+        if (job->n_queries)
+            key = wlmenu_rank_key(job->queries, job->n_queries, store, k);
+
+        if (job->key_limit && key >= job->key_limit)
+            continue;
+
+        wlmenu_rank_item(top, &job->n_top[i], job->max, k, key);
+    }
+}
+
+/*
+ * Short lists are searched right away by the calling thread, so typing
+ * into a small menu never wakes up any worker. The pool is only started
+ * once a list is long enough to be split.
+ */
+static void wlmenu_run_job(struct wlmenu *w,
+                           size_t n_tasks,
+                           void (*func)(void *arg, size_t i),
+                           struct wlmenu_job *job)
+{
+    if (n_tasks <= 1) {
+        for (size_t i = 0; i < n_tasks; ++i)
+            func(job, i);
+
+        return;
+    }
+
+    if (!w->has_pool) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+        pool_init(&w->pool, (n > 1) ? (size_t) n - 1 : 0);
+        w->has_pool = true;
+    }
+
+    pool_run(&w->pool, n_tasks, func, job);
+}
+
+static bool wlmenu_filter_level(struct wlmenu *w,
+                                unsigned long generation,
+                                const struct match_level *prev,
+                                struct match_level *level)
+{
+    struct wlmenu_job job = { .w = w, .generation = generation };
+    size_t n_tasks;
+
+    job.src = prev;
+    job.dst = level;
+
+    job.n = (prev) ? prev->n : w->store.n;
+    n_tasks = (job.n + WLMENU_CHUNK_SIZE - 1) / WLMENU_CHUNK_SIZE;
+
+    job.counts = alloca((n_tasks ? n_tasks : 1) * sizeof(*job.counts));
+
+    match_level_reserve(level, job.n);
+
+    wlmenu_run_job(w, n_tasks, &wlmenu_filter_chunk, &job);
+
+    if (wlmenu_job_cancelled(&job))
+        return false;
+
+    /* Close the gaps between the matches of the chunks */
+    for (size_t i = 0; i < n_tasks; ++i) {
+        size_t *index = level->index + i * WLMENU_CHUNK_SIZE;
+
+        memmove(level->index + level->n, index, job.counts[i] * sizeof(*index));
+        level->n += job.counts[i];
+    }
+
+    return true;
+}
+
+struct wlmenu_filter {
+    const struct wlmenu *w;
+    struct match_level *level;
+};
+
+static void wlmenu_verify_item(uint32_t index, void *arg)
+{
+    struct wlmenu_filter *f = arg;
+    const struct match_query *q = &f->level->query;
+
+    if (store_len(&f->w->store, index) < q->min_len)
+        return;
+
+    if (match_query_find(q, store_folded(&f->w->store, index)))
+        match_level_add(f->level, index);
+}
+
+/*
+ * Look up the candidates of 'level' in the trigram index if that yields
+ * fewer of them than the level below. Trigrams only narrow down the
+ * candidates, so every one of them still has to be verified.
+ */
+static bool wlmenu_filter_index(const struct wlmenu *w,
+                                const struct match_level *prev,
+                                struct match_level *level)
+{
+    struct wlmenu_filter filter = { w, level };
+    size_t n = (prev) ? prev->n : w->store.n;
+
+    if (!w->index || level->query.mode != MATCH_SUBSTRING)
+        return false;
+
+    if (level->query.len < 3)
+        return false;
+
+    if (trigram_estimate(w->index, level->query.str) >= n)
+        return false;
+
+    trigram_intersect(w->index, level->query.str, &wlmenu_verify_item, &filter);
+
+    return true;
+}
+
+/*
+ * The items matching a regular expression are no subset of the ones
+ * matching a prefix of it, so the stack only ever holds a single level,
+ * which is filtered from all items again whenever the input changes.
+ */
+static bool wlmenu_filter_regex(struct wlmenu *w,
+                                const char *str,
+                                size_t len,
+                                unsigned long generation)
+{
+    struct match_level *level = match_stack_top(&w->match);
+
+    if (level && level->query.len == len
+        && memcmp(level->query.str, str, len) == 0)
+        return true;
+
+    match_stack_clear(&w->match);
+
+    if (!len)
+        return true;
+
+    level = match_stack_push(&w->match, str, len);
+
+    if (!wlmenu_filter_level(w, generation, NULL, level)) {
+        match_stack_pop(&w->match);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Bring the candidate stack in sync with the input 'str'. All levels up to
+ * the length of the common prefix with the previous input stay valid.
+ */
+static bool wlmenu_filter_items(struct wlmenu *w,
+                                const char *str,
+                                size_t len,
+                                unsigned long generation)
+{
+    size_t valid;
+
+    if (w->match.mode == MATCH_REGEX)
+        return wlmenu_filter_regex(w, str, len, generation);
+
+    valid = match_stack_common_len(&w->match, str, len);
+
+    while (w->match.depth > valid)
+        match_stack_pop(&w->match);
+
+    while (w->match.depth < len) {
+        const struct match_level *prev = match_stack_top(&w->match);
+        size_t depth = w->match.depth + 1;
+        struct match_level *level;
+
+        /* Pushing may move the levels, so 'prev' has to be looked up again */
+        level = match_stack_push(&w->match, str, depth);
+        prev = (prev) ? &w->match.levels[depth - 2] : NULL;
+
+        if (wlmenu_filter_index(w, prev, level))
+            continue;
+
+        /* A partially filtered level must not be used again */
+        if (!wlmenu_filter_level(w, generation, prev, level)) {
+            match_stack_pop(&w->match);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool wlmenu_is_space(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+static bool wlmenu_has_bit(const uint64_t *bits, size_t i)
+{
+    return bits[i / 64] & UINT64_C(1) << (i % 64);
+}
+
+static void wlmenu_put_bit(uint64_t *bits, size_t i, bool set)
+{
+    uint64_t bit = UINT64_C(1) << (i % 64);
+
+    bits[i / 64] = (set) ? bits[i / 64] | bit : bits[i / 64] & ~bit;
+}
+
+/* The terms have to be matched again once the indices of the items change */
+static void wlmenu_clear_terms(struct wlmenu *w)
+{
+    w->n_terms = 0;
+    w->n_masked = 0;
+}
+
+/* Make room for one bit per item in every bitmap */
+static void wlmenu_reserve_words(struct wlmenu *w)
+{
+    size_t n_words = w->store.n / 64 + 1;
+
+    if (n_words <= w->n_words)
+        return;
+
+    if (n_words < w->n_words * 2)
+        n_words = w->n_words * 2;
+
+    for (size_t i = 0; i < w->n_terms_max; ++i) {
+        uint64_t *bits = w->terms[i].bits;
+
+        w->terms[i].bits = realloc(bits, n_words * sizeof(*bits));
+        if (!w->terms[i].bits)
+            die("Out of memory\n");
+    }
+
+    w->mask = realloc(w->mask, n_words * sizeof(*w->mask));
+    if (!w->mask)
+        die("Out of memory\n");
+
+    w->n_words = n_words;
+}
+
+static struct wlmenu_term *wlmenu_push_term(struct wlmenu *w)
+{
+    if (w->n_terms == w->n_terms_max) {
+        size_t n_max = (w->n_terms_max) ? w->n_terms_max * 2 : 4;
+
+        w->terms = realloc(w->terms, n_max * sizeof(*w->terms));
+        if (!w->terms)
+            die("Out of memory\n");
+
+        for (size_t i = w->n_terms_max; i < n_max; ++i) {
+            match_query_init(&w->terms[i].query);
+
+            w->terms[i].bits = malloc(w->n_words * sizeof(uint64_t));
+            if (!w->terms[i].bits)
+                die("Out of memory\n");
+        }
+
+        w->n_terms_max = n_max;
+    }
+
+    return &w->terms[w->n_terms++];
+}
+
+/*
+ * A term which has just been completed by a space still has its matches on
+ * the candidate stack. Any other one has to be looked up in all items.
+ */
+static const struct match_level *wlmenu_term_matches(struct wlmenu *w,
+                                                     const char *str,
+                                                     size_t len,
+                                                     unsigned long generation)
+{
+    struct match_level *level;
+
+    if (len <= w->match.depth) {
+        level = &w->match.levels[len - 1];
+
+        if (memcmp(level->query.str, str, len) == 0)
+            return level;
+    }
+
+    level = &w->hits;
+    level->n = 0;
+
+    match_query_set(&level->query, str, len, w->match.mode);
+
+    if (wlmenu_filter_index(w, NULL, level))
+        return level;
+
+    if (!wlmenu_filter_level(w, generation, NULL, level))
+        return NULL;
+
+    return level;
+}
+
+static bool wlmenu_add_term(struct wlmenu *w,
+                            const char *str,
+                            size_t len,
+                            unsigned long generation)
+{
+    const struct match_level *level;
+    struct wlmenu_term *term;
+
+    level = wlmenu_term_matches(w, str, len, generation);
+    if (!level)
+        return false;
+
+    term = wlmenu_push_term(w);
+
+    match_query_set(&term->query, str, len, w->match.mode);
+    memset(term->bits, 0, w->n_words * sizeof(*term->bits));
+
+    for (size_t i = 0; i < level->n; ++i)
+        wlmenu_put_bit(term->bits, level->index[i], true);
+
+    return true;
+}
+
+static bool
+wlmenu_term_is(const struct wlmenu_term *t, const char *str, size_t len)
+{
+    return t->query.len == len && memcmp(t->query.str, str, len) == 0;
+}
+
+static void wlmenu_mask_terms(struct wlmenu *w)
+{
+    size_t n_words = (w->store.n + 63) / 64;
+
+    if (!w->n_terms)
+        return;
+
+    memcpy(w->mask, w->terms[0].bits, n_words * sizeof(*w->mask));
+
+    for (size_t i = 1; i < w->n_terms; ++i) {
+        for (size_t j = 0; j < n_words; ++j)
+            w->mask[j] &= w->terms[i].bits[j];
+    }
+}
+
+/*
+ * Bring the terms in sync with the first 'len' characters of the input,
+ * which hold all of its terms but the last one. Known terms keep their
+ * bitmaps, only items appended since they were matched are added to them.
+ */
+static bool wlmenu_sync_terms(struct wlmenu *w,
+                              const char *str,
+                              size_t len,
+                              unsigned long generation)
+{
+    bool changed = false;
+    size_t i = 0, pos = 0;
+
+    wlmenu_reserve_words(w);
+
+    for (size_t k = w->n_masked; k < w->store.n && w->n_terms; ++k) {
+        const char *name = store_folded(&w->store, k);
+
+        for (size_t j = 0; j < w->n_terms; ++j) {
+            struct wlmenu_term *t = &w->terms[j];
+
+            wlmenu_put_bit(t->bits, k, match_query_find(&t->query, name));
+        }
+
+        changed = true;
+    }
+
+    w->n_masked = w->store.n;
+
+    while (pos < len) {
+        size_t begin = pos, n;
+
+        if (wlmenu_is_space(str[pos])) {
+            ++pos;
+            continue;
+        }
+
+        while (pos < len && !wlmenu_is_space(str[pos]))
+            ++pos;
+
+        n = pos - begin;
+
+        if (i < w->n_terms && wlmenu_term_is(&w->terms[i], str + begin, n)) {
+            ++i;
+            continue;
+        }
+
+        w->n_terms = i;
+        changed = true;
+
+        if (!wlmenu_add_term(w, str + begin, n, generation)) {
+            wlmenu_mask_terms(w);
+            return false;
+        }
+
+        ++i;
+    }
+
+    if (w->n_terms != i) {
+        w->n_terms = i;
+        changed = true;
+    }
+
+    if (changed)
+        wlmenu_mask_terms(w);
+
+    return true;
+}
+
+/* Keep the candidates of the last term which match all other terms, too */
+static const struct match_level *
+wlmenu_mask_candidates(struct wlmenu *w, const struct match_level *top)
+{
+    struct match_level *hits = &w->hits;
+
+    hits->n = 0;
+
+    if (top) {
+        match_level_reserve(hits, top->n);
+
+        for (size_t i = 0; i < top->n; ++i) {
+            if (wlmenu_has_bit(w->mask, top->index[i]))
+                hits->index[hits->n++] = top->index[i];
+        }
+
+        return hits;
+    }
+
+    match_level_reserve(hits, w->store.n);
+
+    for (size_t i = 0; i < (w->store.n + 63) / 64; ++i) {
+        uint64_t word = w->mask[i];
+
+        while (word) {
+            size_t k = i * 64 + (size_t) __builtin_ctzll(word);
+
+            if (k >= w->store.n)
+                break;
+
+            hits->index[hits->n++] = k;
+            word &= word - 1;
+        }
+    }
+
+    return hits;
+}
+
+/*
+ * Hand the best matches of a generation over to the user interface. Only
+ * 'final' results are complete, earlier ones merely fill the first rows.
+ */
+static void wlmenu_post_results(struct wlmenu *w,
+                                unsigned long generation,
+                                const struct wlmenu_match *top,
+                                size_t n,
+                                size_t n_matches,
+                                bool final)
+{
+    struct wlmenu_search *s = &w->search;
+    uint64_t val = 1;
+    ssize_t ret;
+
+    pthread_mutex_lock(&s->mutex);
+
+    for (size_t i = 0; i < n; ++i)
+        s->rows[i] = top[i].index;
+
+    s->n_rows = n;
+    s->n_matches = n_matches;
+    s->done = generation;
+    if (final)
+        s->finished = generation;
+
+    pthread_cond_broadcast(&s->cond_done);
+    pthread_mutex_unlock(&s->mutex);
+
+    do {
+        ret = write(s->event_fd, &val, sizeof(val));
+    } while (ret < 0 && errno == EINTR);
+}
+
+/*
+ * Rank the items starting with the input, which are found by a binary
+ * search in the prefix index. Returns the number of such items.
+ */
+static size_t wlmenu_rank_prefix(const struct wlmenu *w,
+                                 const char *str,
+                                 size_t len,
+                                 struct wlmenu_match *top,
+                                 size_t max,
+                                 size_t *n)
+{
+    size_t first, count;
+
+    count = prefix_range(w->prefix, &w->store, str, len, &first);
+
+    for (size_t i = first; i < first + count; ++i) {
+        size_t k = w->prefix->index[i];
+
+        wlmenu_rank_item(top, n, max, k,
+                         wlmenu_substring_key(MATCH_PREFIX, &w->store, k));
+    }
+
+    wlmenu_sort_matches(top, *n);
+
+    return count;
+}
+
+/*
+ * Find the 'max' best matches of the input 'str', which is folded in place,
+ * and count all of them. Every whitespace-separated term of the input has
+ * to match. Substring matches at the start of a name rank before all
+ * others, so for a single term the best rows are taken from the prefix
+ * index and posted right away. The scan of the candidates then only ranks
+ * the other matches into the remaining rows, if any, and counts all of
+ * them. Nothing is posted if the search is cancelled by a newer
+ * generation.
+ */
+static void wlmenu_select_items(struct wlmenu *w,
+                                char *str,
+                                size_t len,
+                                unsigned long generation,
+                                struct wlmenu_match *top,
+                                size_t max)
+{
+    struct wlmenu_job job = { .w = w, .generation = generation, .max = max };
+    const struct match_query **queries;
+    enum match_mode mode = w->mode;
+    struct wlmenu_match *rest;
+    char *last;
+    size_t n_tasks, n = 0, n_rest = 0, n_prefix = 0;
+
+    if (len && str[0] == WLMENU_REGEX_PREFIX) {
+        mode = MATCH_REGEX;
+        ++str;
+        --len;
+    }
+
+    /* The items are searched by their folded names only */
+    if (mode == MATCH_REGEX)
+        dfa_fold(str, str, len);
+    else
+        utf8_fold(str, str, len);
+
+    if (mode != w->match.mode) {
+        match_stack_set_mode(&w->match, mode);
+        wlmenu_clear_terms(w);
+    }
+
+    /*
+     * The last term starts behind the last space of the input. Spaces
+     * are part of a regular expression, which is always a single term.
+     */
+    last = (mode == MATCH_REGEX) ? str : str + len;
+
+    while (last > str && !wlmenu_is_space(last[-1]))
+        --last;
+
+    if (!wlmenu_sync_terms(w, str, (size_t) (last - str), generation))
+        return;
+
+    len -= (size_t) (last - str);
+    str = last;
+
+    if (!w->n_terms && w->prefix && len && w->match.mode == MATCH_SUBSTRING) {
+        n_prefix = wlmenu_rank_prefix(w, str, len, top, max, &n);
+
+        if (n)
+            wlmenu_post_results(w, generation, top, n, n_prefix, false);
+    }
+
+    if (!wlmenu_filter_items(w, str, len, generation))
+        return;
+
+    job.src = match_stack_top(&w->match);
+    if (w->n_terms)
+        job.src = wlmenu_mask_candidates(w, job.src);
+
+    job.n = (job.src) ? job.src->n : w->store.n;
+
+    queries = alloca((w->n_terms + 1) * sizeof(*queries));
+
+    for (size_t i = 0; i < w->n_terms; ++i)
+        queries[job.n_queries++] = &w->terms[i].query;
+
+    if (len)
+        queries[job.n_queries++] = &match_stack_top(&w->match)->query;
+
+    job.queries = queries;
+
+    if (n_prefix >= max) {
+        wlmenu_post_results(w, generation, top, n, job.n, true);
+        return;
+    }
+
+    /* The matches at the start of a name already take the first rows */
+    if (n_prefix)
+        job.key_limit = (uint64_t) MATCH_PREFIX << 48;
+
+    rest = top + n;
+    job.max = max - n;
+
+    n_tasks = (job.n + WLMENU_CHUNK_SIZE - 1) / WLMENU_CHUNK_SIZE;
+
+    if (n_tasks <= 1) {
+        job.top = rest;
+        job.n_top = &n_rest;
+
+        wlmenu_run_job(w, n_tasks, &wlmenu_rank_chunk, &job);
+    } else {
+        job.top = malloc(n_tasks * (job.max ? job.max : 1) * sizeof(*job.top));
+        job.n_top = malloc(n_tasks * sizeof(*job.n_top));
+        if (!job.top || !job.n_top)
+            die("Out of memory\n");
+
+        wlmenu_run_job(w, n_tasks, &wlmenu_rank_chunk, &job);
+
+        for (size_t i = 0; i < n_tasks; ++i) {
+            const struct wlmenu_match *m = job.top + i * job.max;
+
+            for (size_t j = 0; j < job.n_top[i]; ++j)
+                wlmenu_rank_item(rest, &n_rest, job.max, m[j].index, m[j].key);
+        }
+
+        free(job.n_top);
+        free(job.top);
+    }
+
+    if (wlmenu_job_cancelled(&job))
+        return;
+
+    wlmenu_sort_matches(rest, n_rest);
+    wlmenu_post_results(w, generation, top, n + n_rest, job.n, true);
+}
+
+static void *wlmenu_search_thread(void *arg)
+{
+    struct wlmenu *w = arg;
+    struct wlmenu_search *s = &w->search;
+    struct wlmenu_match *top = NULL;
+    char *str = NULL;
+    size_t size = 0, max = 0;
+
+    pthread_mutex_lock(&s->mutex);
+
+    while (1) {
+        unsigned long generation;
+        size_t len;
+
+        while (!s->quit && s->started == atomic_load(&s->generation))
+            pthread_cond_wait(&s->cond_work, &s->mutex);
+
+        if (s->quit)
+            break;
+
+        generation = atomic_load(&s->generation);
+        s->started = generation;
+
+        if (size < s->len + 1) {
+            size = s->len + 1;
+
+            str = realloc(str, size);
+            if (!str)
+                die("Out of memory\n");
+        }
+
+        memcpy(str, s->str, s->len + 1);
+        len = s->len;
+
+        if (max < s->max_rows) {
+            max = s->max_rows;
+
+            top = realloc(top, max * sizeof(*top));
+            s->rows = realloc(s->rows, max * sizeof(*s->rows));
+            if (!top || !s->rows)
+                die("Out of memory\n");
+        }
+
+        pthread_mutex_unlock(&s->mutex);
+
+        pthread_mutex_lock(&s->item_mutex);
+        wlmenu_select_items(w, str, len, generation, top, max);
+        pthread_mutex_unlock(&s->item_mutex);
+
+        pthread_mutex_lock(&s->mutex);
+    }
+
+    pthread_mutex_unlock(&s->mutex);
+
+    free(str);
+    free(top);
+
+    return NULL;
+}
+
+/*
+ * Start a new generation of the search for the current input. The results
+ * arrive asynchronously, so typing never waits for a slow search.
+ */
+static void wlmenu_search(struct wlmenu *w)
+{
+    struct wlmenu_search *s = &w->search;
+    size_t len = widget_input_strlen(&w->widget);
+
+    pthread_mutex_lock(&s->mutex);
+
+    if (s->size < len + 1) {
+        s->size = len + 1;
+
+        s->str = realloc(s->str, s->size);
+        if (!s->str)
+            die("Out of memory\n");
+    }
+
+    memcpy(s->str, widget_input_str(&w->widget), len);
+    s->str[len] = '\0';
+    s->len = len;
+    s->max_rows = widget_max_rows(&w->widget);
+
+    atomic_fetch_add(&s->generation, 1);
+
+    pthread_cond_signal(&s->cond_work);
+    pthread_mutex_unlock(&s->mutex);
+}
+
+/*
+ * Must be called with the mutex held. The names of the rows are copied,
+ * since appending items may move the store before the next results arrive.
+ */
+static void wlmenu_show_results(struct wlmenu *w)
+{
+    struct wlmenu_search *s = &w->search;
+    size_t size = 0;
+    char *p;
+
+    for (size_t i = 0; i < s->n_rows; ++i)
+        size += store_len(&w->store, s->rows[i]) + 1;
+
+    if (w->row_size < size) {
+        w->row_size = size;
+
+        w->row_names = realloc(w->row_names, size);
+        if (!w->row_names)
+            die("Out of memory\n");
+    }
+
+    widget_clear_rows(&w->widget);
+
+    p = w->row_names;
+
+    for (size_t i = 0; i < s->n_rows; ++i) {
+        size_t len = store_len(&w->store, s->rows[i]);
+
+        memcpy(p, store_name(&w->store, s->rows[i]), len + 1);
+        widget_insert_row(&w->widget, p);
+        p += len + 1;
+    }
+
+    widget_set_matches(&w->widget, s->n_matches);
+}
+
+static void wlmenu_receive_results(struct wlmenu *w)
+{
+    struct wlmenu_search *s = &w->search;
+    uint64_t val;
+    bool current;
+
+    (void) read(s->event_fd, &val, sizeof(val));
+
+    pthread_mutex_lock(&s->mutex);
+
+    /* Results of outdated generations are never shown */
+    current = (s->done == atomic_load(&s->generation));
+    if (current)
+        wlmenu_show_results(w);
+
+    pthread_mutex_unlock(&s->mutex);
+
+    if (current)
+        wlmenu_draw(w);
+}
+
+/* Wait until the results of the current input are shown */
+static void wlmenu_finish_search(struct wlmenu *w)
+{
+    struct wlmenu_search *s = &w->search;
+
+    pthread_mutex_lock(&s->mutex);
+
+    while (s->finished != atomic_load(&s->generation))
+        pthread_cond_wait(&s->cond_done, &s->mutex);
+
+    wlmenu_show_results(w);
+
+    pthread_mutex_unlock(&s->mutex);
+}
+
+/*
+ * Modifying the items cancels the search in flight instead of waiting for
+ * it. The search is restarted once the items are released again.
+ */
+static void wlmenu_lock_items(struct wlmenu *w)
+{
+    atomic_fetch_add(&w->search.generation, 1);
+    pthread_mutex_lock(&w->search.item_mutex);
+}
+
+static void wlmenu_unlock_items(struct wlmenu *w)
+{
+    pthread_mutex_unlock(&w->search.item_mutex);
+    wlmenu_search(w);
+}
+
+/* Let the item 'i' of 'store' take part in the ranking */
+static void
+wlmenu_score_item(const struct wlmenu *w, struct store *store, size_t i)
+{
+    const char *name = store_name(store, i);
+
+    store->scores[i] = history_score(&w->history, name, w->now);
+}
+
+static size_t wlmenu_find_item(const struct wlmenu *w, const char *name)
+{
+    return store_find(&w->store, name, &load_compare);
+}
+
+static bool wlmenu_has_item(const struct wlmenu *w, size_t i, const char *name)
+{
+    return i < w->store.n && strcmp(store_name(&w->store, i), name) == 0;
+}
+
+/* The indices of the candidates changed */
+static void wlmenu_reset_search(struct wlmenu *w)
+{
+    match_stack_clear(&w->match);
+    wlmenu_clear_terms(w);
+}
+
+static bool wlmenu_insert_item(struct wlmenu *w, const char *name)
+{
+    size_t i = wlmenu_find_item(w, name);
+
+    if (wlmenu_has_item(w, i, name))
+        return false;
+
+    store_insert(&w->store, i, name);
+    wlmenu_score_item(w, &w->store, i);
+
+    wlmenu_reset_search(w);
+    w->index = NULL;
+    w->prefix = NULL;
+    w->modified = true;
+
+    return true;
+}
+
+static bool wlmenu_remove_item(struct wlmenu *w, const char *name)
+{
+    size_t i = wlmenu_find_item(w, name);
+
+    /* Desktop entries do not depend on the watched directories */
+    if (!wlmenu_has_item(w, i, name) || store_exec(&w->store, i))
+        return false;
+
+    store_remove(&w->store, i);
+
+    wlmenu_reset_search(w);
+    w->index = NULL;
+    w->prefix = NULL;
+    w->modified = true;
+
+    return true;
+}
+
+/* Take over sorted items of the loader, 'items' receives the old ones */
+static void wlmenu_replace_items(struct wlmenu *w, struct store *items)
+{
+    struct store tmp = w->store;
+
+    for (size_t i = 0; i < items->n; ++i)
+        wlmenu_score_item(w, items, i);
+
+    wlmenu_reset_search(w);
+
+    w->store = *items;
+    *items = tmp;
+}
+
+/* Merge sorted items of the loader into the item list */
+static void wlmenu_merge_items(struct wlmenu *w, struct store *items)
+{
+    if (!w->store.n) {
+        wlmenu_replace_items(w, items);
+        return;
+    }
+
+    for (size_t i = 0; i < items->n; ++i)
+        wlmenu_score_item(w, items, i);
+
+    wlmenu_reset_search(w);
+
+    store_merge(&w->store, items, &load_compare);
+}
+
+static size_t wlmenu_find_removal(const struct wlmenu *w, const char *name)
+{
+    size_t i = 0;
+
+    while (i < w->n_removed && strcmp(w->removed[i], name) != 0)
+        ++i;
+
+    return i;
+}
+
+/* Keep 'name' out of the chunks the loader still has to publish */
+static void wlmenu_record_removal(struct wlmenu *w, const char *name)
+{
+    if (!w->loader || wlmenu_find_removal(w, name) < w->n_removed)
+        return;
+
+    if (w->n_removed == w->n_removed_max) {
+        w->n_removed_max = (w->n_removed_max) ? w->n_removed_max * 2 : 16;
+
+        w->removed = realloc(w->removed,
+                             w->n_removed_max * sizeof(*w->removed));
+        if (!w->removed)
+            die("Out of memory\n");
+    }
+
+    w->removed[w->n_removed] = strdup(name);
+    if (!w->removed[w->n_removed])
+        die("Out of memory\n");
+
+    ++w->n_removed;
+}
+
+static void wlmenu_forget_removal(struct wlmenu *w, const char *name)
+{
+    size_t i = wlmenu_find_removal(w, name);
+
+    if (i < w->n_removed) {
+        free(w->removed[i]);
+        w->removed[i] = w->removed[--w->n_removed];
+    }
+}
+
+static void wlmenu_clear_removals(struct wlmenu *w)
 {
-    struct wlmenu *w = data;
+    for (size_t i = 0; i < w->n_removed; ++i)
+        free(w->removed[i]);
 
-    (void) w;
-    (void) output;
-    (void) factor;
-}
+    free(w->removed);
 
-const struct wl_output_listener output_listener = {
-    .geometry = &output_geometry,
-    .mode = &output_mode,
-    .done = &output_done,
-    .scale = &output_scale,
-};
+    w->removed = NULL;
+    w->n_removed = 0;
+    w->n_removed_max = 0;
+}
 
-static void wlmenu_select_items(struct wlmenu *w)
+/* Drop the items from 'items' which were removed since loading began */
+static size_t wlmenu_drop_removals(struct wlmenu *w, struct store *items)
 {
-    const char *input = widget_input_str(&w->widget);
-    size_t len = widget_input_strlen(&w->widget);
-
-    widget_clear_rows(&w->widget);
+    const char *const *names = (const char *const *) w->removed;
 
-    if (!len) {
-        for (size_t i = 0; i < w->n; ++i) {
-            w->items[i].hits = 0;
+    return store_drop(items, names, w->n_removed, &load_compare);
+}
 
-            if (widget_has_empty_row(&w->widget))
-                widget_insert_row(&w->widget, w->items[i].name);
+/*
+ * Bring the item 'name' in sync with the watched directories. The item
+ * stays in the list as long as any of the directories provides it.
+ */
+static bool wlmenu_update_item(struct wlmenu *w, const char *name)
+{
+    for (size_t i = 0; i < w->n_watches; ++i) {
+        if (load_is_item(w->watch_fds[i], name)) {
+            wlmenu_forget_removal(w, name);
+            return wlmenu_insert_item(w, name);
         }
-
-        return;
     }
 
-    for (size_t i = 0; i < w->n; ++i) {
-        int diff = len - w->items[i].hits;
-
-        if (abs(diff) == 1 && strcasestr(w->items[i].name, input))
-            w->items[i].hits = len;
+    wlmenu_record_removal(w, name);
 
-        if (w->items[i].hits == len && widget_has_empty_row(&w->widget))
-            widget_insert_row(&w->widget, w->items[i].name);
-    }
+    return wlmenu_remove_item(w, name);
 }
 
 __attribute__((noreturn))
 static void wlmenu_launch_item(const struct wlmenu *w)
 {
-    const char *file;
+    size_t len = widget_input_strlen(&w->widget);
+    const char *file, *exec;
     char *args[2];
+    size_t i;
 
     file = widget_highlight(&w->widget);
+
+    /*
+     * Exiting or replacing the process would end the loader before it
+     * wrote the cache. Let it finish, the shown items stay as they are.
+     */
+    if (w->loader)
+        loader_wait(w->loader);
+
+    /* Like dmenu, print the input itself if no item matches */
+    if (w->print) {
+        if (file)
+            puts(file);
+        else
+            printf("%.*s\n", (int) len, widget_input_str(&w->widget));
+
+        exit(EXIT_SUCCESS);
+    }
+
     if (!file)
         exit(EXIT_SUCCESS);
 
+    /* Failing to update the history must not keep the item from running */
+    if (w->history_path)
+        (void) history_record(&w->history, w->history_path, file, time(NULL));
+
+    /* Desktop entries provide a command line, which is run without a shell */
+    i = wlmenu_find_item(w, file);
+    exec = (wlmenu_has_item(w, i, file)) ? store_exec(&w->store, i) : NULL;
+    if (exec) {
+        char **argv = desktop_exec_argv(exec);
+
+        if (!argv)
+            die("Invalid command line \"%s\"\n", exec);
+
+        execvp(argv[0], argv);
+
+        die_error(errno, "Failed to execute \"%s\"", argv[0]);
+    }
+
     args[0] = strdupa(file);
     args[1] = NULL;
 
@@ -319,17 +1559,20 @@ static void wlmenu_launch_item(const struct wlmenu *w)
 
 static void wlmenu_dispatch_key_event(struct wlmenu *w, xkb_keysym_t symbol)
 {
+    char buf[8];
+
     switch (symbol) {
     case XKB_KEY_Escape:
         w->quit = true;
         break;
     case XKB_KEY_Return:
+        wlmenu_finish_search(w);
         wlmenu_launch_item(w);
         break;
     case XKB_KEY_BackSpace:
         widget_remove_char(&w->widget);
 
-        wlmenu_select_items(w);
+        wlmenu_search(w);
         break;
     case XKB_KEY_ISO_Left_Tab:
     case XKB_KEY_Up:
@@ -342,9 +1585,12 @@ static void wlmenu_dispatch_key_event(struct wlmenu *w, xkb_keysym_t symbol)
     case XKB_KEY_NoSymbol:
         break;
     default:
-        widget_insert_char(&w->widget, (int) symbol);
-        
-        wlmenu_select_items(w);
+        if (xkb_keysym_to_utf8(symbol, buf, sizeof(buf)) <= 1)
+            break;
+
+        widget_insert_str(&w->widget, buf);
+
+        wlmenu_search(w);
         break;
     }
 
@@ -636,6 +1882,40 @@ static const struct wl_registry_listener registry_listener = {
     .global_remove = &registry_remove,
 };
 
+struct wlmenu_event {
+    void (*run)(struct wlmenu *w);
+};
+
+static void
+wlmenu_add_epoll_event(struct wlmenu *w, int fd, struct wlmenu_event *event)
+{
+    struct epoll_event ev;
+    int err;
+
+    if (w->n_events == WLMENU_MAX_EVENTS)
+        die("wlmenu_add_epoll_event(): Too many event sources\n");
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = event;
+
+    err = epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    if (err < 0)
+        die_error(errno, "epoll_ctl()");
+
+    ++w->n_events;
+}
+
+static void wlmenu_remove_epoll_event(struct wlmenu *w, int fd)
+{
+    int err;
+
+    err = epoll_ctl(w->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    if (err < 0)
+        die_error(errno, "epoll_ctl()");
+
+    --w->n_events;
+}
+
 static void wlmenu_repeat_key(struct wlmenu *w)
 {
     uint64_t val;
@@ -648,6 +1928,234 @@ static void wlmenu_repeat_key(struct wlmenu *w)
     wlmenu_dispatch_key_event(w, w->symbol);
 }
 
+static void wlmenu_reload_items(struct wlmenu *w)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    wlmenu_lock_items(w);
+
+    while (1) {
+        ssize_t size = read(w->inotify_fd, buf, sizeof(buf));
+        if (size < 0 && errno == EINTR)
+            continue;
+
+        if (size <= 0)
+            break;
+
+        for (ssize_t i = 0; i < size;) {
+            const struct inotify_event *ev = (void *) (buf + i);
+
+            i += sizeof(*ev) + ev->len;
+
+            if (ev->len && !(ev->mask & IN_ISDIR))
+                (void) wlmenu_update_item(w, ev->name);
+        }
+    }
+
+    wlmenu_unlock_items(w);
+}
+
+static void wlmenu_receive_items(struct wlmenu *w)
+{
+    struct load_chunk *chunk;
+
+    wlmenu_lock_items(w);
+
+    while (w->loader && (chunk = loader_pop(w->loader))) {
+        size_t n_dropped = wlmenu_drop_removals(w, chunk->store);
+
+        if (!chunk->last) {
+            wlmenu_merge_items(w, chunk->store);
+            load_chunk_free(chunk);
+            continue;
+        }
+
+        /*
+         * The loader is done and all items are owned by us now. Its
+         * complete list replaces the merged one unless the items were
+         * modified since, the indices only apply to the complete list.
+         */
+        if (w->modified || n_dropped) {
+            wlmenu_merge_items(w, chunk->store);
+        } else {
+            wlmenu_replace_items(w, chunk->store);
+            w->index = chunk->index;
+            w->prefix = chunk->prefix;
+        }
+
+        arena_move(&w->arena, &w->loader->arena);
+        wlmenu_remove_epoll_event(w, w->loader->event_fd);
+        w->loader = NULL;
+
+        wlmenu_clear_removals(w);
+
+        load_chunk_free(chunk);
+    }
+
+    wlmenu_unlock_items(w);
+}
+
+/*
+ * Append a line of the input to the items in the order they are read. The
+ * line stays in the buffer of the reader, which the items share.
+ */
+static void wlmenu_add_input_item(char *line, size_t len, void *arg)
+{
+    struct wlmenu *w = arg;
+    size_t i = w->store.n;
+
+    store_add_shared(&w->store, line, len);
+    len = match_stack_match_len(&w->match, store_folded(&w->store, i));
+
+    /*
+     * Appending keeps the indices of all other items, so the new item can
+     * simply be added to every level of the candidate stack it matches.
+     */
+    for (size_t j = 0; j < len; ++j)
+        match_level_add(&w->match.levels[j], i);
+}
+
+/* New items can be shown right away as long as there are empty rows */
+static bool wlmenu_search_has_room(struct wlmenu *w)
+{
+    struct wlmenu_search *s = &w->search;
+    bool room;
+
+    pthread_mutex_lock(&s->mutex);
+
+    room = s->done != atomic_load(&s->generation);
+    room = room || s->n_rows < widget_max_rows(&w->widget);
+
+    pthread_mutex_unlock(&s->mutex);
+
+    return room;
+}
+
+static void wlmenu_search_input(struct wlmenu *w)
+{
+    w->input_pending = false;
+    wlmenu_search(w);
+}
+
+static void wlmenu_delay_input_search(struct wlmenu *w)
+{
+    struct itimerspec its = { 0 };
+    int err;
+
+    if (w->input_pending)
+        return;
+
+    its.it_value.tv_nsec = WLMENU_INPUT_INTERVAL_NS;
+
+    err = timerfd_settime(w->input_timer_fd, 0, &its, NULL);
+    if (err < 0)
+        die_error(errno, "timerfd_settime(): failed to start timer\n");
+
+    w->input_pending = true;
+}
+
+static void wlmenu_input_timeout(struct wlmenu *w)
+{
+    uint64_t val;
+
+    (void) read(w->input_timer_fd, &val, sizeof(val));
+
+    if (w->input_pending)
+        wlmenu_search_input(w);
+}
+
+/*
+ * Appending keeps the candidate stack valid, so reading the input waits for
+ * a running search instead of cancelling it. Once all rows are taken, new
+ * items may still outrank the shown ones and always change the number of
+ * matches. Searching after every read would rank all candidates over and
+ * over again for a long input, so such items are searched when the input
+ * timer expires, i.e. at most once per interval.
+ */
+static ssize_t wlmenu_read_lines(struct wlmenu *w, int fd)
+{
+    size_t n = w->store.n;
+    ssize_t size;
+
+    pthread_mutex_lock(&w->search.item_mutex);
+    size = reader_read(&w->reader, fd, &wlmenu_add_input_item, w);
+    pthread_mutex_unlock(&w->search.item_mutex);
+
+    if (w->store.n == n)
+        return size;
+
+    if (wlmenu_search_has_room(w))
+        wlmenu_search_input(w);
+    else
+        wlmenu_delay_input_search(w);
+
+    return size;
+}
+
+/*
+ * Index the complete input just like a loaded item list. The memory for
+ * building the trigram index grows with the length of all names, so very
+ * large inputs are searched without it.
+ */
+static bool wlmenu_index_input(struct wlmenu *w)
+{
+    struct trigram_index *index;
+    struct prefix_index *prefix;
+    size_t size = 0;
+
+    if (w->store.n < LOAD_INDEX_MIN || w->store.n > UINT32_MAX)
+        return false;
+
+    for (size_t i = 0; i < w->store.n; ++i)
+        size += store_len(&w->store, i);
+
+    if (size > WLMENU_INDEX_MAX_SIZE)
+        return false;
+
+    wlmenu_lock_items(w);
+
+    index = arena_alloc(&w->arena, sizeof(*index));
+    trigram_build(index, &w->store, &w->arena);
+
+    prefix = arena_alloc(&w->arena, sizeof(*prefix));
+    prefix_build(prefix, &w->store, &w->arena);
+
+    w->index = index;
+    w->prefix = prefix;
+    w->input_pending = false;
+
+    /* The indices do not change the candidates, the search just restarts */
+    wlmenu_unlock_items(w);
+
+    return true;
+}
+
+/* The results have to cover all items once the input is complete */
+static void wlmenu_finish_input(struct wlmenu *w)
+{
+    w->input_fd = -1;
+
+    if (wlmenu_index_input(w))
+        return;
+
+    if (w->input_pending)
+        wlmenu_search_input(w);
+}
+
+static void wlmenu_read_input(struct wlmenu *w)
+{
+    ssize_t size;
+
+    size = wlmenu_read_lines(w, w->input_fd);
+    if (size < 0 && size != -EAGAIN)
+        die_error((int) -size, "Failed to read input");
+
+    if (!size) {
+        wlmenu_remove_epoll_event(w, w->input_fd);
+        wlmenu_finish_input(w);
+    }
+}
+
 static void wlmenu_dispatch_messages(struct wlmenu *w)
 {
     int err;
@@ -665,10 +2173,6 @@ static void wlmenu_dispatch_messages(struct wlmenu *w)
         die_error(errno, "Failed to dispatch messages from display connection");
 }
 
-struct wlmenu_event {
-    void (*run)(struct wlmenu *w);
-};
-
 /* clang-format off */
 static struct wlmenu_event wl_display_event = {
     .run = &wlmenu_dispatch_messages
@@ -677,20 +2181,69 @@ static struct wlmenu_event wl_display_event = {
 static struct wlmenu_event key_repeat_event = {
     .run = &wlmenu_repeat_key
 };
+
+static struct wlmenu_event inotify_event = {
+    .run = &wlmenu_reload_items
+};
+
+static struct wlmenu_event load_event = {
+    .run = &wlmenu_receive_items
+};
+
+static struct wlmenu_event input_timer_event = {
+    .run = &wlmenu_input_timeout
+};
+
+static struct wlmenu_event input_event = {
+    .run = &wlmenu_read_input
+};
+
+static struct wlmenu_event search_event = {
+    .run = &wlmenu_receive_results
+};
 /* clang-format on */
 
-static void
-wlmenu_add_epoll_event(struct wlmenu *w, int fd, struct wlmenu_event *event)
+static void wlmenu_init_search(struct wlmenu *w)
 {
-    struct epoll_event ev;
+    struct wlmenu_search *s = &w->search;
     int err;
 
-    ev.events = EPOLLIN;
-    ev.data.ptr = event;
+    pthread_mutex_init(&s->mutex, NULL);
+    pthread_mutex_init(&s->item_mutex, NULL);
+    pthread_cond_init(&s->cond_work, NULL);
+    pthread_cond_init(&s->cond_done, NULL);
 
-    err = epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
-    if (err < 0)
-        die_error(errno, "epoll_ctl()");
+    atomic_init(&s->generation, 0);
+
+    s->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (s->event_fd < 0)
+        die_error(errno, "eventfd()");
+
+    err = pthread_create(&s->thread, NULL, &wlmenu_search_thread, w);
+    if (err != 0)
+        die_error(err, "Failed to create search thread");
+}
+
+static void wlmenu_destroy_search(struct wlmenu *w)
+{
+    struct wlmenu_search *s = &w->search;
+
+    pthread_mutex_lock(&s->mutex);
+    s->quit = true;
+    pthread_cond_signal(&s->cond_work);
+    pthread_mutex_unlock(&s->mutex);
+
+    (void) pthread_join(s->thread, NULL);
+
+    close(s->event_fd);
+
+    pthread_cond_destroy(&s->cond_done);
+    pthread_cond_destroy(&s->cond_work);
+    pthread_mutex_destroy(&s->item_mutex);
+    pthread_mutex_destroy(&s->mutex);
+
+    free(s->rows);
+    free(s->str);
 }
 
 void wlmenu_init(struct wlmenu *w, const char *display_name)
@@ -741,6 +2294,11 @@ void wlmenu_init(struct wlmenu *w, const char *display_name)
     wl_shell_surface_add_listener(w->shell_surface, &shell_surface_listener, w);
 
     widget_init(&w->widget);
+    arena_init(&w->arena);
+    match_stack_init(&w->match);
+    w->mode = MATCH_SUBSTRING;
+    match_level_init(&w->hits);
+    store_init(&w->store);
 
     w->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
     if (w->epoll_fd < 0)
@@ -750,15 +2308,55 @@ void wlmenu_init(struct wlmenu *w, const char *display_name)
     if (w->timer_fd < 0)
         die_error(errno, "timerfd_create()");
 
+    w->inotify_fd = -1;
+    w->input_fd = -1;
+    w->input_timer_fd = -1;
+
+    wlmenu_init_search(w);
+
     wlmenu_add_epoll_event(w, w->timer_fd, &key_repeat_event);
     wlmenu_add_epoll_event(w, wl_display_get_fd(w->display), &wl_display_event);
+    wlmenu_add_epoll_event(w, w->search.event_fd, &search_event);
 }
 
 void wlmenu_destroy(struct wlmenu *w)
 {
+    for (size_t i = 0; i < w->n_watches; ++i)
+        close(w->watch_fds[i]);
+
+    free(w->watch_fds);
+    wlmenu_clear_removals(w);
+
+    if (w->inotify_fd >= 0)
+        close(w->inotify_fd);
+
+    if (w->input_timer_fd >= 0)
+        close(w->input_timer_fd);
+
     close(w->timer_fd);
     close(w->epoll_fd);
 
+    wlmenu_destroy_search(w);
+
+    if (w->has_pool)
+        pool_destroy(&w->pool);
+
+    arena_destroy(&w->arena);
+    free(w->row_names);
+    reader_destroy(&w->reader);
+    match_stack_destroy(&w->match);
+    match_level_destroy(&w->hits);
+    store_destroy(&w->store);
+
+    for (size_t i = 0; i < w->n_terms_max; ++i) {
+        match_query_destroy(&w->terms[i].query);
+        free(w->terms[i].bits);
+    }
+
+    free(w->terms);
+    free(w->mask);
+    history_close(&w->history);
+
     if (w->buffer)
         wl_buffer_destroy(w->buffer);
 
@@ -796,13 +2394,123 @@ struct widget *wlmenu_widget(struct wlmenu *w)
     return &w->widget;
 }
 
-void wlmenu_set_items(struct wlmenu *w, struct item *items, size_t size)
+/*
+ * Rank the items by the launch history stored at 'path' and record every
+ * launched item there. 'path' has to stay valid until 'w' is destroyed.
+ */
+void wlmenu_set_history(struct wlmenu *w, const char *path)
+{
+    history_close(&w->history);
+    history_open(&w->history, path);
+
+    w->history_path = path;
+    w->now = time(NULL);
+
+    for (size_t i = 0; i < w->store.n; ++i)
+        wlmenu_score_item(w, &w->store, i);
+}
+
+void wlmenu_set_match_mode(struct wlmenu *w, enum match_mode mode)
+{
+    w->mode = mode;
+    match_stack_set_mode(&w->match, mode);
+    wlmenu_clear_terms(w);
+}
+
+void wlmenu_set_loader(struct wlmenu *w, struct loader *l)
+{
+    w->loader = l;
+
+    wlmenu_add_epoll_event(w, l->event_fd, &load_event);
+}
+
+/*
+ * Read the items from 'fd' instead of a loader, one per line. Items are
+ * shown as soon as they arrive and the selected one is printed to stdout
+ * instead of being run.
+ */
+void wlmenu_set_input(struct wlmenu *w, int fd)
+{
+    struct epoll_event ev;
+    ssize_t size;
+    int err;
+
+    reader_init(&w->reader);
+    store_share_names(&w->store, w->reader.buf);
+
+    w->input_fd = fd;
+    w->print = true;
+
+    w->input_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (w->input_timer_fd < 0)
+        die_error(errno, "timerfd_create()");
+
+    wlmenu_add_epoll_event(w, w->input_timer_fd, &input_timer_event);
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = &input_event;
+
+    err = epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    if (err == 0) {
+        ++w->n_events;
+        return;
+    }
+
+    if (errno != EPERM)
+        die_error(errno, "epoll_ctl()");
+
+    /* Regular files cannot be polled, but are never slow to read either */
+    do {
+        size = wlmenu_read_lines(w, fd);
+    } while (size > 0);
+
+    if (size < 0)
+        die_error((int) -size, "Failed to read input");
+
+    wlmenu_finish_input(w);
+}
+
+void wlmenu_watch_dirs(struct wlmenu *w, const char *path)
 {
-    w->items = items;
-    w->n = size;
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                          | IN_ATTRIB | IN_ONLYDIR;
+    char *iter = strdupa(path);
+    size_t n = 1;
+
+    if (w->inotify_fd >= 0)
+        die("wlmenu_watch_dirs(): Directories are already watched\n");
+
+    for (const char *p = path; *p != '\0'; ++p) {
+        if (*p == ':')
+            ++n;
+    }
+
+    w->watch_fds = malloc(n * sizeof(*w->watch_fds));
+    if (!w->watch_fds)
+        die("Out of memory\n");
+
+    w->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w->inotify_fd < 0)
+        die_error(errno, "inotify_init1()");
+
+    while (iter) {
+        const char *dir = strsep(&iter, ":");
+        int fd, err;
+
+        fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        err = inotify_add_watch(w->inotify_fd, dir, mask);
+        if (err < 0) {
+            close(fd);
+            continue;
+        }
+
+        w->watch_fds[w->n_watches++] = fd;
+    }
 
-    for (size_t i = 0; i < w->n && widget_has_empty_row(&w->widget); ++i)
-        widget_insert_row(&w->widget, w->items[i].name);
+    wlmenu_add_epoll_event(w, w->inotify_fd, &inotify_event);
 }
 
 void wlmenu_show(struct wlmenu *w)
@@ -812,7 +2520,7 @@ void wlmenu_show(struct wlmenu *w)
 
 void wlmenu_mainloop(struct wlmenu *w)
 {
-    struct epoll_event events[2];
+    struct epoll_event events[WLMENU_MAX_EVENTS];
 
     while (!w->quit) {
         wl_display_flush(w->display);
@@ -25,12 +25,72 @@
 #ifndef WLMENU_H_
 #define WLMENU_H_
 
+#include <pthread.h>
+#include <stdatomic.h>
+
 #include <wayland-client.h>
 
 #include "xkb.h"
 #include "widget.h"
 
+#include "arena.h"
+#include "history.h"
 #include "load.h"
+#include "match.h"
+#include "pool.h"
+#include "prefix.h"
+#include "reader.h"
+#include "store.h"
+#include "trigram.h"
+
+/*
+ * State shared with the thread which searches the items in the background.
+ * Every change of the input starts a new generation of the search, which
+ * cancels the one still in flight.
+ */
+struct wlmenu_search {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_work;
+    pthread_cond_t cond_done;
+
+    /* Held by a running search and by every modification of the items */
+    pthread_mutex_t item_mutex;
+
+    /* The latest requested generation */
+    atomic_ulong generation;
+
+    /*
+     * Generation taken up by the thread, the one of 'rows' and the last
+     * one whose search ran to completion
+     */
+    unsigned long started;
+    unsigned long done;
+    unsigned long finished;
+
+    /* Input of the latest request */
+    char *str;
+    size_t len;
+    size_t size;
+    size_t max_rows;
+
+    /* Items of the best matches and the number of all matches */
+    size_t *rows;
+    size_t n_rows;
+    size_t n_matches;
+
+    int event_fd;
+    bool quit;
+};
+
+/*
+ * A term of the input in front of the last one. The items matching it are
+ * kept as a bitmap, so all terms can be intersected word by word.
+ */
+struct wlmenu_term {
+    struct match_query query;
+    uint64_t *bits;
+};
 
 struct wlmenu {
     struct xkb xkb;
@@ -65,21 +125,98 @@ struct wlmenu {
     struct widget widget;
 
     /* Runnable commands */
-    struct item *items;
-    size_t n;
+    struct store store;
+
+    /* Backing memory of the indices provided by the loader */
+    struct arena arena;
+
+    /* Copies of the names of the shown rows */
+    char *row_names;
+    size_t row_size;
+
+    /* Candidates of the incremental search */
+    struct match_stack match;
+    struct wlmenu_search search;
+
+    /* Mode of any input which is not a regular expression */
+    enum match_mode mode;
+
+    /*
+     * The input only ever changes at its end, so all of its terms but the
+     * last one stay the same while typing. They are matched once and
+     * intersected in 'mask', the last one is left to the candidate stack.
+     */
+    struct wlmenu_term *terms;
+    size_t n_terms;
+    size_t n_terms_max;
+
+    uint64_t *mask;
+    size_t n_words;
+    size_t n_masked;
+
+    /* Candidates of the search which match all terms */
+    struct match_level hits;
+
+    /* Workers searching long item lists, started on first use */
+    struct pool pool;
+    bool has_pool;
+
+    /* Indices of the items, as long as they are not modified */
+    const struct trigram_index *index;
+    const struct prefix_index *prefix;
+
+    /* Source of runnable commands while they are still being loaded */
+    struct loader *loader;
+
+    /* Source of items read line by line, e.g. from stdin */
+    struct reader reader;
+    int input_fd;
+
+    /* Delays the search for items read while all rows are taken */
+    int input_timer_fd;
+
+    /* Launch history ranking the runnable commands */
+    struct history history;
+    const char *history_path;
+    time_t now;
+
+    /* Watched directories providing the runnable commands */
+    int *watch_fds;
+    size_t n_watches;
+
+    /*
+     * Names removed from the watched directories while the loader runs.
+     * Its chunks may have been read before a removal, so these names are
+     * dropped from every chunk which is received.
+     */
+    char **removed;
+    size_t n_removed;
+    size_t n_removed_max;
 
     /* Keyboard configuration */
     int32_t rate;
     int32_t delay;
     xkb_keysym_t symbol;
 
+    /* Number of file descriptors registered with 'epoll_fd' */
+    size_t n_events;
     int epoll_fd;
     int timer_fd;
+    int inotify_fd;
 
     uint8_t show : 1;
     uint8_t released : 1;
     uint8_t dirty : 1;
     uint8_t quit : 1;
+
+    /* The items deviate from the ones provided by the loader */
+    uint8_t modified : 1;
+
+    /* Print the selected item instead of running it */
+    uint8_t print : 1;
+
+    /* Items were read which no search took into account yet */
+    uint8_t input_pending : 1;
 };
 
 void wlmenu_init(struct wlmenu *w, const char *display_name);
@@ -92,7 +229,15 @@ void wlmenu_set_window_class(struct wlmenu *w, const char *name);
 
 struct widget *wlmenu_widget(struct wlmenu *w);
 
-void wlmenu_set_items(struct wlmenu *w, struct item *items, size_t size);
+void wlmenu_set_history(struct wlmenu *w, const char *path);
+
+void wlmenu_set_match_mode(struct wlmenu *w, enum match_mode mode);
+
+void wlmenu_set_loader(struct wlmenu *w, struct loader *l);
+
+void wlmenu_set_input(struct wlmenu *w, int fd);
+
+void wlmenu_watch_dirs(struct wlmenu *w, const char *path);
 
 void wlmenu_show(struct wlmenu *w);
 
@@ -0,0 +1,352 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Parsing of desktop entries, the quoting rules of their "Exec" key and
+ * the labels of entries with the same name.
+ */
+
+#include <errno.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../src/desktop.h"
+#include "../src/proc-util.h"
+#include "test.h"
+
+static char tmp[PATH_MAX];
+
+static void write_file(const char *path, const char *content)
+{
+    FILE *file = fopen(path, "w");
+
+    if (!file)
+        die_error(errno, "Failed to create \"%s\"", path);
+
+    fputs(content, file);
+    fclose(file);
+}
+
+static void make_dir(const char *path)
+{
+    if (mkdir(path, 0755) < 0 && errno != EEXIST)
+        die_error(errno, "Failed to create \"%s\"", path);
+}
+
+static int remove_entry(const char *path,
+                        const struct stat *st,
+                        int flag,
+                        struct FTW *ftw)
+{
+    (void) st;
+    (void) flag;
+    (void) ftw;
+
+    return remove(path);
+}
+
+static void parse(struct desktop_file *file, const char *content)
+{
+    static unsigned int n;
+    char path[PATH_MAX + 64];
+
+    snprintf(path, sizeof(path), "%s/parse-%u.desktop", tmp, n++);
+    write_file(path, content);
+
+    memset(file, 0, sizeof(*file));
+    file->path = path;
+
+    desktop_parse(file);
+
+    file->path = NULL;
+    unlink(path);
+}
+
+static void check_parse(void)
+{
+    struct desktop_file file;
+
+    parse(&file,
+          "# comment\n"
+          "[Desktop Entry]\n"
+          "Type=Application\n"
+          "Name = Text\\sEditor \n"
+          "Exec=editor %F\n"
+          "TryExec=editor\n"
+          "\n"
+          "[Desktop Action new]\n"
+          "Name=Other\n");
+
+    check(file.name && strcmp(file.name, "Text Editor") == 0,
+          "Name: \"%s\"",
+          file.name);
+    check(file.exec && strcmp(file.exec, "editor %F") == 0,
+          "Exec: \"%s\"",
+          file.exec);
+    check(file.try_exec && strcmp(file.try_exec, "editor") == 0,
+          "TryExec: \"%s\"",
+          file.try_exec);
+    free(file.buf);
+
+    parse(&file, "[Desktop Entry]\nType=Link\nName=Link\nExec=app\n");
+    check(!file.name, "entry of type Link is shown");
+    free(file.buf);
+
+    parse(&file, "[Desktop Entry]\nType=Application\nName=A\nExec=a\n"
+                 "NoDisplay=true\n");
+    check(!file.name, "entry with NoDisplay is shown");
+    free(file.buf);
+
+    parse(&file, "[Desktop Entry]\nType=Application\nName=A\nExec=a\n"
+                 "Hidden=true\n");
+    check(!file.name, "hidden entry is shown");
+    free(file.buf);
+
+    parse(&file, "[Other]\n[Desktop Entry]\nType=Application\nName=A\n"
+                 "Exec=a\n");
+    check(!file.name, "entry without leading group is shown");
+    free(file.buf);
+
+    parse(&file, "[Desktop Entry]\nType=Application\nName=A\n"
+                 "Exec=a \"unterminated\n");
+    check(!file.name, "entry with an invalid command line is shown");
+    free(file.buf);
+
+    parse(&file, "[Desktop Entry]\nType=Application\nName=A\nExec=%f %U\n");
+    check(!file.name, "entry with only field codes is shown");
+    free(file.buf);
+}
+
+static void check_exec(const char *line, ...)
+{
+    struct desktop_file file;
+    char content[512];
+    const char *arg;
+    char **argv;
+    va_list ap;
+    size_t i = 0;
+
+    snprintf(content,
+             sizeof(content),
+             "[Desktop Entry]\nType=Application\nName=A\nExec=%s\n",
+             line);
+
+    parse(&file, content);
+
+    check(file.exec, "Exec=%s: entry is not shown", line);
+    if (!file.exec) {
+        free(file.buf);
+        return;
+    }
+
+    argv = desktop_exec_argv(file.exec);
+
+    va_start(ap, line);
+
+    while ((arg = va_arg(ap, const char *))) {
+        check(argv[i] && strcmp(argv[i], arg) == 0,
+              "Exec=%s: argument %zu is \"%s\", expected \"%s\"",
+              line,
+              i,
+              argv[i] ? argv[i] : "(null)",
+              arg);
+
+        if (!argv[i])
+            break;
+
+        ++i;
+    }
+
+    va_end(ap);
+
+    if (!arg)
+        check(!argv[i], "Exec=%s: extra argument \"%s\"", line, argv[i]);
+
+    free(argv);
+    free(file.buf);
+}
+
+static void check_exec_args(void)
+{
+    check_exec("firefox %u", "firefox", NULL);
+    check_exec("  app   -a  -b  ", "app", "-a", "-b", NULL);
+    check_exec("\"/opt/My App/app\" --flag %F",
+               "/opt/My App/app",
+               "--flag",
+               NULL);
+    check_exec("sh -c \"echo \\\\$HOME \\\\\\\\ \\\\`x\\\\`\"",
+               "sh",
+               "-c",
+               "echo $HOME \\ `x`",
+               NULL);
+    check_exec("sh -c \"echo \\\"hi\\\"\"", "sh", "-c", "echo \"hi\"", NULL);
+    check_exec("app --file=%f 100%%", "app", "--file=", "100%", NULL);
+    check_exec("app \"\" \"%f\"", "app", "", "%f", NULL);
+    check_exec("a\\sb\\tc", "a", "b", "c", NULL);
+    check_exec("env A=\"x y\"z app", "env", "A=x yz", "app", NULL);
+    check_exec("app a\\ b", "app", "a b", NULL);
+}
+
+static struct desktop_file make_file(char *id, char *name, bool shown)
+{
+    struct desktop_file file;
+
+    memset(&file, 0, sizeof(file));
+    file.id = id;
+    file.name = name;
+    file.shown = shown;
+
+    return file;
+}
+
+static void check_labels(void)
+{
+    struct desktop_file files[] = {
+        make_file("org.gnome.Terminal.desktop", "Terminal", true),
+        make_file("editor.desktop", "Editor", true),
+        make_file("xterm.desktop", "Terminal", true),
+        make_file("hidden.desktop", "Editor", false),
+        make_file("broken.desktop", NULL, false),
+    };
+    static const char *labels[] = {
+        "Terminal (org.gnome.Terminal)",
+        "Editor",
+        "Terminal (xterm)",
+        "Editor",
+        NULL,
+    };
+    struct arena arena;
+
+    arena_init(&arena);
+
+    desktop_set_labels(files, sizeof(files) / sizeof(files[0]), &arena);
+
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+        const char *label = files[i].label;
+
+        if (!labels[i]) {
+            check(!label, "label of entry %zu: \"%s\"", i, label);
+            continue;
+        }
+
+        check(label && strcmp(label, labels[i]) == 0,
+              "label of entry %zu: \"%s\", expected \"%s\"",
+              i,
+              label ? label : "(null)",
+              labels[i]);
+    }
+
+    arena_destroy(&arena);
+}
+
+static void check_list(void)
+{
+    char dirs[2 * PATH_MAX + 64], path[PATH_MAX + 64];
+    struct desktop_file *files;
+    struct arena arena;
+    size_t n;
+
+    snprintf(path, sizeof(path), "%s/a", tmp);
+    make_dir(path);
+    snprintf(path, sizeof(path), "%s/a/applications", tmp);
+    make_dir(path);
+    snprintf(path, sizeof(path), "%s/a/applications/kde", tmp);
+    make_dir(path);
+    snprintf(path, sizeof(path), "%s/b", tmp);
+    make_dir(path);
+    snprintf(path, sizeof(path), "%s/b/applications", tmp);
+    make_dir(path);
+
+    snprintf(path, sizeof(path), "%s/a/applications/app.desktop", tmp);
+    write_file(path, "");
+    snprintf(path, sizeof(path), "%s/a/applications/kde/app.desktop", tmp);
+    write_file(path, "");
+    snprintf(path, sizeof(path), "%s/b/applications/app.desktop", tmp);
+    write_file(path, "");
+    snprintf(path, sizeof(path), "%s/b/applications/other.desktop", tmp);
+    write_file(path, "");
+    snprintf(path, sizeof(path), "%s/b/applications/readme.txt", tmp);
+    write_file(path, "");
+
+    snprintf(dirs, sizeof(dirs), "%s/a:relative:%s/b", tmp, tmp);
+
+    arena_init(&arena);
+
+    n = desktop_list_files(dirs, &files, &arena);
+
+    /* The entry in the first directory hides the one in the second */
+    check(n == 3, "listed %zu entries, expected 3", n);
+
+    for (size_t i = 0; i < n; ++i) {
+        const char *rel = files[i].path + strlen(tmp);
+
+        if (strcmp(rel, "/a/applications/app.desktop") == 0)
+            check(strcmp(files[i].id, "app.desktop") == 0,
+                  "ID \"%s\"",
+                  files[i].id);
+        else if (strcmp(rel, "/a/applications/kde/app.desktop") == 0)
+            check(strcmp(files[i].id, "kde-app.desktop") == 0,
+                  "ID \"%s\"",
+                  files[i].id);
+        else if (strcmp(rel, "/b/applications/other.desktop") == 0)
+            check(strcmp(files[i].id, "other.desktop") == 0,
+                  "ID \"%s\"",
+                  files[i].id);
+        else
+            check(false, "unexpected entry \"%s\"", files[i].path);
+    }
+
+    free(files);
+    arena_destroy(&arena);
+}
+
+int main(void)
+{
+    const char *dir = getenv("TMPDIR");
+    int err;
+
+    if (!dir || !dir[0])
+        dir = "/tmp";
+
+    snprintf(tmp, sizeof(tmp), "%s/wlmenu-test-XXXXXX", dir);
+    if (!mkdtemp(tmp))
+        die_error(errno, "Failed to create a directory in \"%s\"", dir);
+
+    check_parse();
+    check_exec_args();
+    check_labels();
+    check_list();
+
+    err = nftw(tmp, &remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    if (err < 0)
+        die_error(errno, "Failed to remove \"%s\"", tmp);
+
+    return test_finish("desktop entries");
+}
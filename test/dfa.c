@@ -0,0 +1,192 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Expressions are compiled from the input with only the case of their
+ * escapes kept and matched against folded names. They have to agree with
+ * regexec() on every plain expression.
+ */
+
+#include <regex.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/dfa.h"
+#include "../src/utf8.h"
+#include "test.h"
+
+/* Match 'str' with the expression 'pattern' as the menu does */
+static int match(const char *pattern, const char *str)
+{
+    char p[256], s[256];
+    struct dfa *d;
+    bool ret;
+
+    dfa_fold(p, pattern, strlen(pattern) + 1);
+    utf8_fold(s, str, strlen(str) + 1);
+
+    d = dfa_compile(p, strlen(p));
+    if (!d)
+        return -1;
+
+    ret = dfa_match(d, s);
+    dfa_free(d);
+
+    return ret;
+}
+
+static void check_cases(void)
+{
+    static const struct {
+        const char *pattern;
+        const char *str;
+        int expect;
+    } cases[] = {
+        { "fire", "Firefox", 1 },
+        { "FIRE", "firefox", 1 },
+        { "^f.*x$", "Firefox", 1 },
+        { "^ox", "Firefox", 0 },
+        { "[A-C]", "Blender", 1 },
+        { "[^a-z]", "Blender", 0 },
+        { "gimp|inkscape", "Inkscape", 1 },
+        { "(ab)+c", "xababc", 1 },
+        { "ab?c", "ac", 1 },
+        { "\\d", "vlc2", 1 },
+        { "\\d", "vlc", 0 },
+        { "^\\D+$", "vlc", 1 },
+        { "^\\D+$", "vlc2", 0 },
+        { "\\w\\W\\w", "foo-bar", 1 },
+        { "\\W", "Foo_Bar2", 0 },
+        { "\\s", "Foo Bar", 1 },
+        { "^\\S+$", "Foo Bar", 0 },
+        { "^\\S+$", "FooBar", 1 },
+        { "[\\D]", "123", 0 },
+        { "[\\Da]", "12a", 1 },
+        { "[^\\S]", "a b", 1 },
+        { "a\\tb", "a\tb", 1 },
+        { "\\\\D", "\\d", 1 },
+        { "\\.", "a.b", 1 },
+        { "\\.", "ab", 0 },
+        { "\xc3\x89t\xc3\xa9", "\xc3\xa9T\xc3\x89", 1 },
+        { "^.$", "\xc3\xa9", 1 },
+        { "[\xc3\xa0-\xc3\xaa]", "Caf\xc3\x89", 1 },
+        { "\\D\\D", "\xc3\xa9", 0 },
+        { "(", "", -1 },
+        { "a)", "", -1 },
+        { "*a", "", -1 },
+        { "[b-a]", "", -1 },
+        { "[ab", "", -1 },
+        { "\\q", "", -1 },
+        { "\\Q", "", -1 },
+        { "a\\", "", -1 },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); ++i) {
+        int ret = match(cases[i].pattern, cases[i].str);
+
+        check(ret == cases[i].expect,
+              "\"%s\" on \"%s\": %d, expected %d",
+              cases[i].pattern,
+              cases[i].str,
+              ret,
+              cases[i].expect);
+    }
+}
+
+/* Append a random expression of at most 'depth' nested groups to 'buf' */
+static void random_expr(char *buf, unsigned long *state, int depth)
+{
+    static const char *atoms[] = { "a", "b", "B", ".", "[ab]", "[^a]" };
+    static const char *repeats[] = { "*", "+", "?" };
+    size_t n = 1 + test_rand(state) % 4;
+
+    for (size_t i = 0; i < n; ++i) {
+        unsigned int r = test_rand(state) % 10;
+
+        if (r == 0 && depth) {
+            strcat(buf, "(");
+            random_expr(buf, state, depth - 1);
+            strcat(buf, (test_rand(state) % 2) ? "|" : ")");
+
+            if (buf[strlen(buf) - 1] == '|') {
+                random_expr(buf, state, depth - 1);
+                strcat(buf, ")");
+            }
+        } else {
+            strcat(buf, atoms[test_rand(state) % 6]);
+        }
+
+        if (test_rand(state) % 3 == 0)
+            strcat(buf, repeats[test_rand(state) % 3]);
+    }
+}
+
+static void check_random(void)
+{
+    unsigned long state = 1;
+
+    for (size_t round = 0; round < 2000; ++round) {
+        char pattern[256] = "", str[16];
+        regex_t re;
+
+        if (test_rand(&state) % 4 == 0)
+            strcat(pattern, "^");
+
+        random_expr(pattern, &state, 2);
+
+        if (test_rand(&state) % 4 == 0)
+            strcat(pattern, "$");
+
+        if (regcomp(&re, pattern, REG_EXTENDED | REG_ICASE | REG_NOSUB))
+            continue;
+
+        for (size_t i = 0; i < 20; ++i) {
+            size_t n = test_rand(&state) % sizeof(str) + 1;
+            int expect;
+
+            for (size_t j = 0; j < n - 1; ++j)
+                str[j] = "abAB-"[test_rand(&state) % 5];
+
+            str[n - 1] = '\0';
+            expect = regexec(&re, str, 0, NULL, 0) == 0;
+
+            check(match(pattern, str) == expect,
+                  "\"%s\" on \"%s\": expected %d",
+                  pattern,
+                  str,
+                  expect);
+        }
+
+        regfree(&re);
+    }
+}
+
+int main(void)
+{
+    check_cases();
+    check_random();
+
+    return test_finish("regular expressions");
+}
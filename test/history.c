@@ -0,0 +1,180 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The launch history must find every recorded item, reject files whose
+ * entries are out of order and forget items which were not launched for
+ * a long time.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/history.h"
+#include "../src/proc-util.h"
+#include "test.h"
+
+#define DAY (24 * 60 * 60)
+
+static char path[PATH_MAX];
+
+static uint32_t score(const char *name, time_t now)
+{
+    struct history h;
+    uint32_t n;
+
+    history_open(&h, path);
+    n = history_score(&h, name, now);
+    history_close(&h);
+
+    return n;
+}
+
+static void record(const char *name, time_t now)
+{
+    struct history h;
+    int err;
+
+    history_open(&h, path);
+    err = history_record(&h, path, name, now);
+    history_close(&h);
+
+    check(err == 0, "recording \"%s\" failed: %s", name, strerror(-err));
+}
+
+static void check_record(void)
+{
+    const time_t now = 1000 * DAY;
+
+    record("vim", now);
+    record("firefox", now);
+    record("vim", now);
+    record("alacritty", now);
+
+    check(score("vim", now) == 16, "vim: %u", score("vim", now));
+    check(score("firefox", now) == 8, "firefox: %u", score("firefox", now));
+    check(score("alacritty", now) == 8, "alacritty");
+    check(score("foot", now) == 0, "foot was never launched");
+
+    check(score("vim", now + 2 * DAY) == 4, "vim after two days");
+    check(score("vim", now + 30 * DAY) == 1, "vim after a month");
+    check(score("vim", now + 100 * DAY) == 0, "vim after 100 days");
+}
+
+static void check_prune(void)
+{
+    const time_t now = 2000 * DAY;
+
+    record("old", now);
+    record("old", now);
+    record("recent", now + 60 * DAY);
+
+    /* Launched twice two months ago, which still counts */
+    check(score("old", now) == 16, "old was dropped too early");
+
+    record("recent", now + 100 * DAY);
+
+    check(score("old", now) == 0, "old was not dropped");
+    check(score("recent", now + 100 * DAY) == 16, "recent");
+}
+
+/* A single launch a month ago still counts and survives recording */
+static void check_single(void)
+{
+    const time_t now = 2500 * DAY;
+
+    record("once", now);
+
+    check(score("once", now + 30 * DAY) == 1,
+          "once: %u",
+          score("once", now + 30 * DAY));
+
+    record("other", now + 30 * DAY);
+
+    check(score("once", now + 30 * DAY) == 1, "once was dropped");
+    check(score("once", now + 90 * DAY) == 0, "once after 90 days");
+}
+
+/* Swap the names of the first two entries, which breaks their order */
+static void check_order(void)
+{
+    const time_t now = 3000 * DAY;
+    char buf[4096];
+    size_t size;
+    FILE *file;
+
+    record("aaa", now);
+    record("bbb", now);
+
+    check(score("aaa", now) == 8, "aaa before corrupting the file");
+
+    file = fopen(path, "r+");
+    if (!file)
+        die_error(errno, "Failed to open \"%s\"", path);
+
+    size = fread(buf, 1, sizeof(buf), file);
+    check(size > 8 && memcmp(buf + size - 8, "aaa\0bbb\0", 8) == 0,
+          "unexpected layout of the history file");
+
+    memcpy(buf + size - 8, "bbb\0aaa\0", 8);
+    rewind(file);
+    fwrite(buf, 1, size, file);
+    fclose(file);
+
+    check(score("aaa", now) == 0, "unsorted file was accepted");
+    check(score("bbb", now) == 0, "unsorted file was accepted");
+}
+
+int main(void)
+{
+    const char *dir = getenv("TMPDIR");
+    char tmp[PATH_MAX - sizeof("/history")];
+
+    if (!dir || !dir[0])
+        dir = "/tmp";
+
+    snprintf(tmp, sizeof(tmp), "%s/wlmenu-test-XXXXXX", dir);
+    if (!mkdtemp(tmp))
+        die_error(errno, "Failed to create a directory in \"%s\"", dir);
+
+    snprintf(path, sizeof(path), "%s/history", tmp);
+
+    check_record();
+    unlink(path);
+    check_prune();
+    unlink(path);
+    check_single();
+    unlink(path);
+    check_order();
+    unlink(path);
+
+    rmdir(tmp);
+
+    return test_finish("launch history");
+}
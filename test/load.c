@@ -0,0 +1,140 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The item list must be sorted exactly as strverscmp() sorts it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/load.h"
+#include "test.h"
+
+static int sign(int x)
+{
+    return (x > 0) - (x < 0);
+}
+
+static void check_pair(const char *a, const char *b)
+{
+    int expect = sign(strverscmp(a, b));
+    int got = sign(load_compare(a, b));
+
+    check(got == expect,
+          "load_compare(\"%s\", \"%s\") = %d, expected %d",
+          a,
+          b,
+          got,
+          expect);
+}
+
+static void check_chain(void)
+{
+    /* The example from the manual page of strverscmp() */
+    static const char *chain[] = {
+        "000", "00", "01", "010", "09", "0", "1", "9", "10",
+    };
+    size_t n = sizeof(chain) / sizeof(chain[0]);
+
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j)
+            check_pair(chain[i], chain[j]);
+
+        if (i > 0)
+            check(load_compare(chain[i - 1], chain[i]) < 0,
+                  "\"%s\" does not sort before \"%s\"",
+                  chain[i - 1],
+                  chain[i]);
+    }
+}
+
+static void check_names(void)
+{
+    static const char *names[][2] = {
+        { "a01", "a1" },
+        { "x007", "x7" },
+        { "x7", "x10" },
+        { "python3.9", "python3.10" },
+        { "gcc-12", "gcc-9" },
+        { "lib0a", "lib00" },
+        { "a0.1", "a0-1" },
+        { "v1.010", "v1.01" },
+        { "v01b", "v012" },
+        { "foo", "foo1" },
+        { "12345678901234567890", "9" },
+        { "0000000000000000000001", "01" },
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        check_pair(names[i][0], names[i][1]);
+        check_pair(names[i][1], names[i][0]);
+    }
+}
+
+static void check_random(void)
+{
+    static const char alphabet[] = "00012389a.-\xff";
+    unsigned long state = 1;
+    char a[16], b[16];
+
+    for (size_t i = 0; i < 500000; ++i) {
+        size_t len_a = test_rand(&state) % sizeof(a);
+        size_t len_b = test_rand(&state) % sizeof(b);
+
+        for (size_t j = 0; j < len_a; ++j)
+            a[j] = alphabet[test_rand(&state) % (sizeof(alphabet) - 1)];
+
+        /* Mostly compare names with a common prefix */
+        if (test_rand(&state) % 2) {
+            size_t n = test_rand(&state) % (len_a + 1);
+
+            memcpy(b, a, n);
+
+            for (size_t j = n; j < len_b; ++j)
+                b[j] = alphabet[test_rand(&state) % (sizeof(alphabet) - 1)];
+
+            if (len_b < n)
+                len_b = n;
+        } else {
+            for (size_t j = 0; j < len_b; ++j)
+                b[j] = alphabet[test_rand(&state) % (sizeof(alphabet) - 1)];
+        }
+
+        a[len_a < sizeof(a) ? len_a : sizeof(a) - 1] = '\0';
+        b[len_b < sizeof(b) ? len_b : sizeof(b) - 1] = '\0';
+
+        check_pair(a, b);
+    }
+}
+
+int main(void)
+{
+    check_chain();
+    check_names();
+    check_random();
+
+    return test_finish("version order");
+}
@@ -0,0 +1,267 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The search kernels have to agree with strcasestr() on every input, in
+ * particular for strings which end right before an unmapped page. Fuzzy
+ * matches have to compare whole characters.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "../src/match.c"
+#include "test.h"
+
+struct kernel {
+    const char *name;
+    bool (*find)(const struct match_query *q, const char *str);
+};
+
+static struct kernel kernels[3];
+static size_t n_kernels;
+
+static const size_t needle_lens[] = { 1, 2, 3, 15, 16, 17, 31, 32, 33, 64 };
+
+static void init_kernels(void)
+{
+    kernels[n_kernels++] = (struct kernel){ "scalar", &match_find_scalar };
+
+#ifdef __SSE2__
+    kernels[n_kernels++] = (struct kernel){ "sse2", &match_find_sse2 };
+
+    if (__builtin_cpu_supports("avx2"))
+        kernels[n_kernels++] = (struct kernel){ "avx2", &match_find_avx2 };
+    else
+        printf("match kernels: avx2 not supported, skipped\n");
+#endif
+}
+
+/* Few different characters, so there are many partial matches */
+static void fill(char *str, size_t len, unsigned long *state)
+{
+    static const char alphabet[] = "aAbB-";
+
+    for (size_t i = 0; i < len; ++i)
+        str[i] = alphabet[test_rand(state) % (sizeof(alphabet) - 1)];
+
+    str[len] = '\0';
+}
+
+static void fold(char *dst, const char *src, size_t len)
+{
+    for (size_t i = 0; i <= len; ++i)
+        dst[i] = (char) tolower((unsigned char) src[i]);
+}
+
+/*
+ * Search 'hay' with all kernels. The folded copy is placed right before
+ * 'guard', so its terminating null byte is the last mapped byte.
+ */
+static void check_search(struct match_query *q,
+                         const char *needle,
+                         const char *hay,
+                         char *guard)
+{
+    size_t len = strlen(hay);
+    char *str = guard - len - 1;
+    bool expect = strcasestr(hay, needle) != NULL;
+
+    fold(str, hay, len);
+
+    for (size_t i = 0; i < n_kernels; ++i) {
+        bool found = kernels[i].find(q, str);
+
+        check(found == expect,
+              "%s: \"%s\" in \"%s\": %d, expected %d",
+              kernels[i].name,
+              needle,
+              hay,
+              found,
+              expect);
+    }
+}
+
+static void check_page_end(char *guard)
+{
+    unsigned long state = 1;
+    struct match_query q;
+    char needle[65], hay[256], tmp[65];
+
+    match_query_init(&q);
+
+    for (size_t i = 0; i < sizeof(needle_lens) / sizeof(*needle_lens); ++i) {
+        size_t n = needle_lens[i];
+
+        for (size_t round = 0; round < 2000; ++round) {
+            size_t len = test_rand(&state) % 200;
+
+            fill(needle, n, &state);
+            fold(tmp, needle, n);
+            match_query_set(&q, tmp, n, MATCH_SUBSTRING);
+
+            fill(hay, len, &state);
+
+            /* Plant the needle, often at the very end or cut off by it */
+            if (len && test_rand(&state) % 2) {
+                size_t pos = len - 1 - test_rand(&state) % (n + 1);
+
+                if (pos >= len)
+                    pos = 0;
+
+                for (size_t j = 0; j < n && pos + j < len; ++j)
+                    hay[pos + j] = needle[j];
+            }
+
+            check_search(&q, needle, hay, guard);
+        }
+    }
+
+    match_query_destroy(&q);
+}
+
+#define ALPHA "abcdefghijklmnopqrstuvwxyz"
+
+static void check_cases(char *guard)
+{
+    static const char *cases[][2] = {
+        { "a", "" },
+        { "a", "A" },
+        { "ab", "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxab" },
+        { "ab", "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxa" },
+        { "abcdefghijklmnop", "xabcdefghijklmnop" },
+        { "abcdefghijklmnop", "abcdefghijklmnoabcdefghijklmnoP" },
+        { ALPHA "012345", ALPHA "012345" },
+        { ALPHA "0123456", ALPHA "012345" },
+        { ALPHA "0123456", "-" ALPHA "0123456" },
+    };
+    struct match_query q;
+    char tmp[64];
+
+    match_query_init(&q);
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); ++i) {
+        size_t n = strlen(cases[i][0]);
+
+        fold(tmp, cases[i][0], n);
+        match_query_set(&q, tmp, n, MATCH_SUBSTRING);
+
+        check_search(&q, cases[i][0], cases[i][1], guard);
+    }
+
+    match_query_destroy(&q);
+}
+
+static int fuzzy_score(struct match_query *q, const char *str)
+{
+    char folded[1024];
+    size_t len = strlen(str);
+
+    utf8_fold(folded, str, len + 1);
+
+    if (!q->find(q, folded))
+        return SCORE_NONE;
+
+    return match_query_score(q, str, folded);
+}
+
+static void check_fuzzy(void)
+{
+    struct match_query q;
+    char str[1024];
+
+    match_query_init(&q);
+
+    match_query_set(&q, "\xc3\x89", 2, MATCH_FUZZY);
+    check(q.n_chars == 1, "\"\xc3\x89\" is %zu characters", q.n_chars);
+
+    /* The bytes of "é" appear in order in "ã©", the character does not */
+    check(fuzzy_score(&q, "\xc3\x83\xc2\xa9") == SCORE_NONE, "split bytes");
+    check(fuzzy_score(&q, "caf\xc3\xa9") > 0, "caf\xc3\xa9");
+
+    /* Only the character which starts a word gets the bonus */
+    check(fuzzy_score(&q, "caf \xc3\xa9") > fuzzy_score(&q, "caf\xc3\xa9"),
+          "bonus at the start of a word");
+
+    /* Gaps are as long as the characters skipped, not their bytes */
+    match_query_set(&q, "ab", 2, MATCH_FUZZY);
+    check(fuzzy_score(&q, "a\xc3\xa9" "b") > fuzzy_score(&q, "axxb"), "gap");
+    check(fuzzy_score(&q, "a\xc3\xa9" "b") == fuzzy_score(&q, "axb"), "gap");
+
+    /* Items too long for the alignment are scored greedily */
+    match_query_set(&q, "\xc3\xa9", 2, MATCH_FUZZY);
+
+    str[0] = '\0';
+    for (size_t i = 0; i < 200; ++i)
+        strcat(str, "\xc3\x83\xc2\xa9");
+
+    check(fuzzy_score(&q, str) == SCORE_NONE, "long item without a match");
+
+    strcat(str, "\xc3\x89");
+    check(fuzzy_score(&q, str) == SCORE_MATCH,
+          "long item scored %d",
+          fuzzy_score(&q, str));
+
+    /* A character cut off by a prefix of the input is left out */
+    match_query_set(&q, "x\xc3", 2, MATCH_FUZZY);
+    check(q.n_chars == 1, "cut off character");
+    check(fuzzy_score(&q, "x\xc3\xa9") > 0, "cut off character");
+
+    /* Invalid bytes only match themselves */
+    match_query_set(&q, "\xa9", 1, MATCH_FUZZY);
+    check(fuzzy_score(&q, "\xc2\xa9") == SCORE_NONE, "invalid byte");
+    check(fuzzy_score(&q, "x\xa9") > 0, "invalid byte");
+
+    match_query_destroy(&q);
+}
+
+int main(void)
+{
+    char *mem;
+
+    init_kernels();
+
+    /* Any read past the end of the first page faults */
+    mem = mmap(NULL,
+               2 * MATCH_PAGE_SIZE,
+               PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS,
+               -1,
+               0);
+    if (mem == MAP_FAILED || mprotect(mem + MATCH_PAGE_SIZE,
+                                      MATCH_PAGE_SIZE,
+                                      PROT_NONE) < 0)
+        die("Failed to map the guard page\n");
+
+    check_cases(mem + MATCH_PAGE_SIZE);
+    check_page_end(mem + MATCH_PAGE_SIZE);
+    check_fuzzy();
+
+    munmap(mem, 2 * MATCH_PAGE_SIZE);
+
+    return test_finish("match kernels");
+}
@@ -0,0 +1,326 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * The store is the item list of the menu: Merging, inserting and removing
+ * items has to keep every name, folded name, score and command line
+ * together, whether the store owns their memory or not.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/store.h"
+#include "test.h"
+
+static int compare(const char *a, const char *b)
+{
+    return strcmp(a, b);
+}
+
+static const char *str(const char *s)
+{
+    return (s) ? s : "(null)";
+}
+
+static void check_item(const struct store *s,
+                       size_t i,
+                       const char *name,
+                       const char *exec,
+                       uint32_t score)
+{
+    check(strcmp(store_name(s, i), name) == 0,
+          "item %zu is \"%s\", expected \"%s\"",
+          i,
+          store_name(s, i),
+          name);
+    check(store_len(s, i) == strlen(name), "length of \"%s\"", name);
+    check(strcmp(str(store_exec(s, i)), str(exec)) == 0,
+          "command line of \"%s\" is \"%s\", expected \"%s\"",
+          name,
+          str(store_exec(s, i)),
+          str(exec));
+    check(s->scores[i] == score,
+          "score of \"%s\" is %u, expected %u",
+          name,
+          s->scores[i],
+          score);
+}
+
+static void check_fold(void)
+{
+    struct store s;
+
+    store_init(&s);
+    store_add(&s, "\xc3\x84pfel-Baum");
+
+    check(strcmp(store_name(&s, 0), "\xc3\x84pfel-Baum") == 0, "name");
+    check(strcmp(store_folded(&s, 0), "\xc3\xa4pfel-baum") == 0,
+          "folded name is \"%s\"",
+          store_folded(&s, 0));
+    check(store_exec(&s, 0) == NULL, "no command line");
+
+    store_destroy(&s);
+}
+
+static void check_merge(void)
+{
+    struct store s, src;
+
+    store_init(&s);
+    store_init(&src);
+
+    store_add(&s, "a1");
+    store_add(&s, "a3");
+    store_add(&s, "a5");
+    s.scores[2] = 5;
+
+    store_add(&src, "a0");
+    store_add(&src, "a3");
+    store_add(&src, "a4");
+    store_add(&src, "a6");
+    store_set_exec(&src, 1, "three");
+    store_set_exec(&src, 3, "six");
+    src.scores[0] = 1;
+    src.scores[3] = 6;
+
+    store_merge(&s, &src, &compare);
+
+    check(s.n == 6, "%zu items after the merge, expected 6", s.n);
+    check_item(&s, 0, "a0", NULL, 1);
+    check_item(&s, 1, "a1", NULL, 0);
+    check_item(&s, 2, "a3", NULL, 0);
+    check_item(&s, 3, "a4", NULL, 0);
+    check_item(&s, 4, "a5", NULL, 5);
+    check_item(&s, 5, "a6", "six", 6);
+
+    store_insert(&s, 2, "a2");
+    s.scores[2] = 2;
+    store_remove(&s, 1);
+
+    check(s.n == 6, "%zu items after insert and remove, expected 6", s.n);
+    check_item(&s, 0, "a0", NULL, 1);
+    check_item(&s, 1, "a2", NULL, 2);
+    check_item(&s, 2, "a3", NULL, 0);
+    check_item(&s, 5, "a6", "six", 6);
+
+    store_destroy(&src);
+    store_destroy(&s);
+}
+
+/*
+ * Names shared with the caller are not copied and read-only items are used
+ * in place, until the store is modified.
+ */
+static void check_shared(void)
+{
+    char names[] = "b1\0b2\0b3";
+    struct store s, view;
+
+    store_init(&s);
+    store_share_names(&s, names);
+
+    for (size_t i = 0; i < 3; ++i)
+        store_add_shared(&s, names + 3 * i, 2);
+
+    check(store_name(&s, 1) == names + 3, "the name was copied");
+    check(strcmp(store_folded(&s, 2), "b3") == 0, "folded name");
+
+    store_init_view(&view, s.names, s.folds, s.size, s.offsets, s.lens,
+                    NULL, s.n);
+
+    store_remove(&view, 0);
+    store_set_exec(&view, 0, "two");
+    store_insert(&view, 0, "b0");
+
+    check(view.n == 3, "%zu items in the view, expected 3", view.n);
+    check_item(&view, 0, "b0", NULL, 0);
+    check_item(&view, 1, "b2", "two", 0);
+    check_item(&view, 2, "b3", NULL, 0);
+
+    /* The memory of the view was left alone */
+    check(s.n == 3, "%zu shared items, expected 3", s.n);
+    check_item(&s, 0, "b1", NULL, 0);
+    check(store_name(&s, 0) == names, "the shared names moved");
+
+    store_destroy(&view);
+    store_destroy(&s);
+}
+
+/* Reordering keeps the names in place and drops the unlisted items */
+static void check_reorder(void)
+{
+    const uint32_t order[] = { 2, 0 };
+    struct store s;
+    const char *name;
+
+    store_init(&s);
+    store_add(&s, "c1");
+    store_add(&s, "c2");
+    store_add(&s, "c0");
+    store_set_exec(&s, 0, "one");
+    s.scores[2] = 3;
+
+    name = store_name(&s, 2);
+    store_reorder(&s, order, 2);
+
+    check(s.n == 2, "%zu items after reordering, expected 2", s.n);
+    check(store_name(&s, 0) == name, "the name was moved");
+    check_item(&s, 0, "c0", NULL, 3);
+    check_item(&s, 1, "c1", "one", 0);
+
+    store_destroy(&s);
+}
+
+static void add_items(struct store *s, const char *const *names, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        store_add(s, names[i]);
+}
+
+/*
+ * Files deleted while the menu is loading: The chunks of the loader may
+ * have been read before the deletion, so the removed names are dropped
+ * from every chunk merged afterwards, including the complete list.
+ */
+static void check_remove_during_load(void)
+{
+    static const char *chunk1[] = { "a1", "a3" };
+    static const char *chunk2[] = { "a4", "a5" };
+    static const char *all[] = { "a1", "a3", "a4", "a5" };
+    const char *removed[] = { "a5", "a3" };
+    struct store s, chunk, last, desktop;
+    size_t n;
+
+    store_init(&s);
+    store_init(&chunk);
+    store_init(&last);
+    store_init(&desktop);
+
+    add_items(&s, chunk1, 2);
+
+    /* "a5" is deleted before its chunk arrives */
+    add_items(&chunk, chunk2, 2);
+    n = store_drop(&chunk, removed, 1, &compare);
+    check(n == 1, "%zu items dropped from the chunk, expected 1", n);
+    store_merge(&s, &chunk, &compare);
+
+    /* "a3" is deleted after its chunk was merged */
+    store_remove(&s, store_find(&s, "a3", &compare));
+
+    add_items(&last, all, 4);
+    n = store_drop(&last, removed, 2, &compare);
+    check(n == 2, "%zu items dropped from the last chunk, expected 2", n);
+    store_merge(&s, &last, &compare);
+
+    check(s.n == 2, "%zu items after loading, expected 2", s.n);
+    check_item(&s, 0, "a1", NULL, 0);
+    check_item(&s, 1, "a4", NULL, 0);
+
+    /* A desktop entry of the same name is no file which was deleted */
+    store_add(&desktop, "a3");
+    store_set_exec(&desktop, 0, "run");
+    n = store_drop(&desktop, removed, 2, &compare);
+    check(n == 0, "the desktop entry was dropped");
+    check_item(&desktop, 0, "a3", "run", 0);
+
+    store_destroy(&desktop);
+    store_destroy(&last);
+    store_destroy(&chunk);
+    store_destroy(&s);
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *) a, *(const char *const *) b);
+}
+
+/* Random sorted lists, the merge yields their sorted union */
+static void check_random(void)
+{
+    unsigned long state = 1;
+
+    for (int round = 0; round < 200; ++round) {
+        static char names[2][64][8];
+        const char *list[2][64], *all[128];
+        struct store s[2];
+        size_t n[2], n_all = 0, k = 0;
+
+        for (int i = 0; i < 2; ++i) {
+            store_init(&s[i]);
+            n[i] = test_rand(&state) % 64;
+
+            for (size_t j = 0; j < n[i]; ++j) {
+                snprintf(names[i][j], 8, "%u", test_rand(&state) % 100);
+                list[i][j] = names[i][j];
+            }
+
+            qsort(list[i], n[i], sizeof(*list[i]), &compare_names);
+
+            for (size_t j = 0; j < n[i]; ++j) {
+                if (j && strcmp(list[i][j - 1], list[i][j]) == 0)
+                    continue;
+
+                store_add(&s[i], list[i][j]);
+                store_set_exec(&s[i], s[i].n - 1, (i) ? list[i][j] : NULL);
+                all[n_all++] = list[i][j];
+            }
+        }
+
+        qsort(all, n_all, sizeof(*all), &compare_names);
+
+        store_merge(&s[0], &s[1], &compare);
+
+        for (size_t i = 0; i < n_all; ++i) {
+            if (i && strcmp(all[i - 1], all[i]) == 0)
+                continue;
+
+            if (k < s[0].n)
+                check(strcmp(store_name(&s[0], k), all[i]) == 0,
+                      "merged item %zu is \"%s\", expected \"%s\"",
+                      k,
+                      store_name(&s[0], k),
+                      all[i]);
+            ++k;
+        }
+
+        check(s[0].n == k, "%zu merged items, expected %zu", s[0].n, k);
+
+        store_destroy(&s[1]);
+        store_destroy(&s[0]);
+    }
+}
+
+int main(void)
+{
+    check_fold();
+    check_merge();
+    check_shared();
+    check_reorder();
+    check_remove_during_load();
+    check_random();
+
+    return test_finish("item store");
+}
@@ -0,0 +1,129 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * The trigram index must yield exactly the items which contain all
+ * trigrams of a query, in ascending order.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/arena.h"
+#include "../src/store.h"
+#include "../src/trigram.h"
+#include "test.h"
+
+struct result {
+    uint32_t index[4096];
+    size_t n;
+};
+
+static void collect(uint32_t index, void *arg)
+{
+    struct result *r = arg;
+
+    r->index[r->n++] = index;
+}
+
+static bool has_trigrams(const char *name, const char *str)
+{
+    for (size_t i = 0; str[i] && str[i + 1] && str[i + 2]; ++i) {
+        char tri[4] = { str[i], str[i + 1], str[i + 2], '\0' };
+
+        if (!strstr(name, tri))
+            return false;
+    }
+
+    return true;
+}
+
+static void check_random(void)
+{
+    static const char alphabet[] = "abcd";
+    unsigned long state = 1;
+
+    for (int round = 0; round < 20; ++round) {
+        struct trigram_index index;
+        struct arena arena;
+        struct store s;
+        size_t n = 1 + test_rand(&state) % 4000;
+
+        store_init(&s);
+        arena_init(&arena);
+
+        for (size_t i = 0; i < n; ++i) {
+            char name[16];
+            size_t len = test_rand(&state) % sizeof(name);
+
+            for (size_t j = 0; j < len; ++j)
+                name[j] = alphabet[test_rand(&state) % (sizeof(alphabet) - 1)];
+
+            name[len] = '\0';
+            store_add(&s, name);
+        }
+
+        trigram_build(&index, &s, &arena);
+
+        for (int query = 0; query < 50; ++query) {
+            static struct result r, expect;
+            char str[8];
+            size_t len = 3 + test_rand(&state) % (sizeof(str) - 3);
+
+            for (size_t j = 0; j < len; ++j)
+                str[j] = alphabet[test_rand(&state) % (sizeof(alphabet) - 1)];
+
+            str[len] = '\0';
+            r.n = 0;
+            expect.n = 0;
+
+            trigram_intersect(&index, str, &collect, &r);
+
+            for (size_t i = 0; i < n; ++i) {
+                if (has_trigrams(store_folded(&s, i), str))
+                    collect((uint32_t) i, &expect);
+            }
+
+            check(r.n == expect.n
+                      && memcmp(r.index, expect.index, r.n * sizeof(*r.index))
+                             == 0,
+                  "\"%s\": %zu items, expected %zu",
+                  str,
+                  r.n,
+                  expect.n);
+        }
+
+        arena_destroy(&arena);
+        store_destroy(&s);
+    }
+}
+
+int main(void)
+{
+    check_random();
+
+    return test_finish("trigram index");
+}
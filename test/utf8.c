@@ -0,0 +1,167 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2018 Steffen Nuessle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/*
+ * Folding has to keep the length of every string, so folded names line up
+ * with the originals, decoding has to reject what is not UTF-8 and text
+ * shown to the user has to be valid UTF-8 afterwards.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/utf8.h"
+#include "test.h"
+
+static void check_fold(void)
+{
+    static const char *cases[][2] = {
+        { "Firefox", "firefox" },
+        { "\xc3\x84pfel \xc3\x96l", "\xc3\xa4pfel \xc3\xb6l" },
+        { "\xc5\xb8", "\xc3\xbf" },
+        { "\xce\xa3\xce\xbf\xcf\x86\xce\xaf\xce\xb1",
+          "\xcf\x83\xce\xbf\xcf\x86\xce\xaf\xce\xb1" },
+        { "\xd0\x9c\xd0\xb8\xd1\x80", "\xd0\xbc\xd0\xb8\xd1\x80" },
+        { "\xc2\xb5", "\xce\xbc" },
+        /* The Kelvin sign would fold to a shorter 'k' */
+        { "\xe2\x84\xaa", "\xe2\x84\xaa" },
+        /* Invalid and truncated sequences are copied unchanged */
+        { "A\xff" "B\xc3", "a\xff" "b\xc3" },
+        { "\xc3\x28X", "\xc3\x28x" },
+        { "\xe2\x82", "\xe2\x82" },
+    };
+    char buf[64];
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); ++i) {
+        size_t len = strlen(cases[i][0]);
+
+        memset(buf, 0, sizeof(buf));
+        utf8_fold(buf, cases[i][0], len);
+
+        check(strlen(cases[i][1]) == len, "case %zu changes the length", i);
+        check(memcmp(buf, cases[i][1], len) == 0, "case %zu: \"%s\"", i, buf);
+        check(buf[len] == '\0', "case %zu writes past its end", i);
+    }
+
+    /* In place */
+    strcpy(buf, "\xc3\x89t\xc3\xa9 ABC");
+    utf8_fold(buf, buf, strlen(buf));
+    check(strcmp(buf, "\xc3\xa9t\xc3\xa9 abc") == 0, "in place: \"%s\"", buf);
+}
+
+static void check_decode(void)
+{
+    static const struct {
+        const char *str;
+        size_t len;
+        uint32_t c;
+    } cases[] = {
+        { "a", 1, 'a' },
+        { "\xc3\xa4", 2, 0xe4 },
+        { "\xe2\x82\xac", 3, 0x20ac },
+        { "\xf0\x9f\x98\x80", 4, 0x1f600 },
+        { "\x80", 0, 0 },
+        { "\xc0\xaf", 0, 0 },
+        { "\xc3" "a", 0, 0 },
+        { "\xf5\x80\x80\x80", 0, 0 },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); ++i) {
+        const char *str = cases[i].str;
+        uint32_t c = 0;
+        size_t n = utf8_decode(str, strlen(str), &c);
+
+        check(n == cases[i].len, "case %zu: length %zu", i, n);
+        check(!n || c == cases[i].c, "case %zu: U+%04X", i, (unsigned int) c);
+    }
+
+    /* A sequence cut off by the end of the string is invalid */
+    check(utf8_decode("\xe2\x82\xac", 2, &(uint32_t){ 0 }) == 0, "cut off");
+}
+
+static void check_last_len(void)
+{
+    check(utf8_last_len("ab", 2) == 1, "ASCII");
+    check(utf8_last_len("a\xc3\xa4", 3) == 2, "two bytes");
+    check(utf8_last_len("\xe2\x82\xac", 3) == 3, "three bytes");
+    check(utf8_last_len("\xf0\x9f\x98\x80", 4) == 4, "four bytes");
+    check(utf8_last_len("\x80\x80\x80\x80\x80", 5) == 4, "stray bytes");
+}
+
+static void check_complete_len(void)
+{
+    check(utf8_complete_len("", 0) == 0, "empty");
+    check(utf8_complete_len("ab", 2) == 2, "ASCII");
+    check(utf8_complete_len("a\xc3", 2) == 1, "two bytes, cut off");
+    check(utf8_complete_len("a\xc3\xa4", 3) == 3, "two bytes");
+    check(utf8_complete_len("\xe2\x82", 2) == 0, "three bytes, cut off");
+    check(utf8_complete_len("\xf0\x9f\x98", 3) == 0, "four bytes, cut off");
+    check(utf8_complete_len("a\x80", 2) == 2, "stray byte");
+    check(utf8_complete_len("a\xff", 2) == 2, "invalid byte");
+}
+
+static void check_sanitize(void)
+{
+    static const char *cases[][2] = {
+        { "firefox", "firefox" },
+        { "\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\x80",
+          "\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\x80" },
+        { "a\xff" "b", "a" UTF8_REPLACEMENT "b" },
+        { "\xc3(", UTF8_REPLACEMENT "(" },
+        { "log\xe2\x82", "log" UTF8_REPLACEMENT UTF8_REPLACEMENT },
+        /* Overlong encodings, surrogates and code points beyond U+10FFFF */
+        { "\xe0\x80\xaf", UTF8_REPLACEMENT UTF8_REPLACEMENT UTF8_REPLACEMENT },
+        { "\xed\xa0\x80", UTF8_REPLACEMENT UTF8_REPLACEMENT UTF8_REPLACEMENT },
+        { "\xf4\x90\x80\x80",
+          UTF8_REPLACEMENT UTF8_REPLACEMENT UTF8_REPLACEMENT UTF8_REPLACEMENT },
+    };
+    char buf[64];
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(*cases); ++i) {
+        const char *str = cases[i][0];
+        size_t len = strlen(str);
+        bool valid = strcmp(str, cases[i][1]) == 0;
+        size_t n = utf8_sanitize(buf, str, len);
+
+        check(utf8_is_valid(str, len) == valid, "case %zu: validity", i);
+        check(n == strlen(cases[i][1]) && memcmp(buf, cases[i][1], n) == 0,
+              "case %zu: \"%.*s\"",
+              i,
+              (int) n,
+              buf);
+        check(utf8_is_valid(buf, n), "case %zu: copy is invalid", i);
+    }
+}
+
+int main(void)
+{
+    check_fold();
+    check_decode();
+    check_last_len();
+    check_complete_len();
+    check_sanitize();
+
+    return test_finish("utf-8");
+}